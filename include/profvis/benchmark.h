@@ -0,0 +1,14 @@
+#pragma once
+
+#include "profile-canvas.h"
+
+namespace profvis
+{
+
+// Collects the views that a width x height window shows at increasing zoom, centred on the middle of
+// the run, and prints the time and the counters of each, so that rendering can be compared between builds.
+// Needs no OpenGL context.
+void
+benchmark(ProfileCanvas& canvas, size_t repeats, int width = 1200, int height = 800);
+
+}
@@ -3,6 +3,10 @@
 #include <nanogui/widget.h>
 #include <nanogui/opengl.h>
 
+#include <unordered_map>
+
+struct NVGLUframebuffer;
+
 namespace profvis
 {
 
@@ -11,14 +15,25 @@ class Canvas: public nanogui::Widget
     public:
         enum class State { None, Drag, Select };
 
+        struct View
+        {
+            nanogui::Vector2f   min, max;       // visible rectangle, in content coordinates
+            nanogui::Vector2f   scale;          // pixels per unit of content
+        };
+
     public:
                         Canvas(nanogui::Widget* parent):
                             nanogui::Widget(parent)                 { nvgTransformIdentity(&mTransform[0]); }
 
         void            transform(NVGcontext* ctx) const;
+        View            view(const std::array<float,6>& xform, nanogui::Vector2i pos, nanogui::Vector2i size) const;
 
         virtual void    draw(NVGcontext* ctx) override;
+        // render the missing tiles of the view into the offscreen cache; must be called outside of a NanoVG frame
+        void            update_cache(NVGcontext* ctx, float pixel_ratio);
+        virtual void    damage()                                                { mDirty = true; }   // contents changed, drop the tiles
         virtual void    drawContents(NVGcontext* ctx)                           {}
+        virtual void    drawOverlay(NVGcontext* ctx)                            {}      // untransformed, on top of the contents
 
         virtual void    select(nanogui::Vector2f min, nanogui::Vector2f max)    {}
 
@@ -27,12 +42,63 @@ class Canvas: public nanogui::Widget
         virtual bool    mouseMotionEvent(const nanogui::Vector2i &p, const nanogui::Vector2i &rel, int button, int modifiers) override;
         virtual bool    scrollEvent(const nanogui::Vector2i &p, const nanogui::Vector2f &rel) override;
 
+    protected:
+        virtual         ~Canvas();
+
+        void            render(NVGcontext* ctx, const std::array<float,6>& xform, nanogui::Vector2i pos, nanogui::Vector2i size);
+
+        // tile cache: the contents at a given zoom, cut into squares of tile_size pixels
+        struct TileKey
+        {
+            float   scale_x, scale_y;
+            int     phase_x, phase_y;       // sub-pixel part of the translation, in 1/64 of a pixel
+            int     i, j;                   // column (time) and row (rank) of the tile
+
+            bool    operator==(const TileKey& o) const  { return scale_x == o.scale_x && scale_y == o.scale_y &&
+                                                                 phase_x == o.phase_x && phase_y == o.phase_y &&
+                                                                 i == o.i && j == o.j; }
+        };
+        struct TileHash
+        {
+            size_t  operator()(const TileKey& k) const
+            {
+                size_t h = std::hash<float>()(k.scale_x) ^ (std::hash<float>()(k.scale_y) << 1);
+                h = h * 31 + (k.phase_x << 6 | k.phase_y);
+                h = h * 31 + std::hash<int>()(k.i);
+                h = h * 31 + std::hash<int>()(k.j);
+                return h;
+            }
+        };
+        struct Tile
+        {
+            NVGLUframebuffer*   fb;
+            size_t              used;       // frame in which the tile was last needed
+        };
+        using Tiles = std::unordered_map<TileKey, Tile, TileHash>;
+
+        static constexpr int    tile_size = 256;
+
+        TileKey         tile_key(int i, int j) const;
+        void            visible_tiles(int margin, nanogui::Vector2i& first, nanogui::Vector2i& last) const;
+        void            clear_tiles();
+
     protected:
         // controls
         nanogui::Vector2i       mStart, mLast;
         std::array<float, 6>    mTransform;
         bool                    mActive = false;
         State                   mState = State::None;
+
+        View                    mView;          // set by draw() for drawContents()
+
+        // cached rendering of the contents
+        Tiles                   mTiles;
+        bool                    mTiled      = false;    // tiles are available, draw() composites them
+        bool                    mDirty      = true;
+        float                   mTileRatio  = 0;
+        size_t                  mFrame      = 0;
+        size_t                  mMaxTiles   = 192;
+        int                     mTileBudget = 8;        // milliseconds per frame for prefetching
 };
 
 }
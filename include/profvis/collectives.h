@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "profile.h"
+
+namespace profvis
+{
+
+// Collective calls lined up across the ranks: the k-th call of a collective name on every rank
+// belongs to its k-th instance (communicators aren't recorded, so all the ranks that make the call
+// are assumed to take part); a collective nested in another one is part of the outer call. An instance
+// can't complete before its last rank arrives; the time the others spend in the call until then is their wait.
+struct Collectives
+{
+    struct Instance
+    {
+        size_t          name;
+        size_t          number;             // k-th call of the name
+        Profile::Time   first, last;        // earliest and latest arrival
+        size_t          late_rank;          // the rank that arrived last (the lowest one, on a tie)
+        size_t          late_index;         // position of its arrival in ranks[late_rank]
+        Profile::Time   wait;               // over all the ranks
+        size_t          ranks;              // that make the call
+    };
+
+    struct Arrival
+    {
+        size_t          instance;
+        Profile::Time   begin, end;
+        Profile::Time   wait;
+        size_t          depth, index;       // position of the event in the EventIndex
+    };
+
+    // Stretch of the critical path: computing on a rank until a collective, or inside a collective
+    // once everyone has arrived.
+    struct Segment
+    {
+        size_t          rank;
+        Profile::Time   begin, end;
+        bool            collective;
+    };
+
+    // ranks that made the others wait the longest, first
+    std::vector<size_t>         offenders(size_t n) const;
+
+    std::vector<Instance>               instances;      // by name, then number
+    std::vector<std::vector<Arrival>>   ranks;          // per rank, in time order
+    std::vector<Profile::Time>          waited;         // per rank, time spent waiting for the last arrivals
+    std::vector<Profile::Time>          caused;         // per rank, time the others waited while it was late
+    std::vector<size_t>                 worst;          // per rank, the instance where it caused the longest wait, or -1
+    std::vector<Segment>                critical_path;  // in time order
+};
+
+// MPI_Barrier, MPI_Allreduce, MPI_Bcast, ...
+bool            is_collective(const std::string& name);
+
+// Runs in parallel over the ranks.
+Collectives     analyze_collectives(const Profile& profile);
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+#include "profile.h"
+
+namespace profvis
+{
+
+// How many ranks are inside each name over time: for every name and bucket, the average number
+// of ranks in the name during the bucket. The memory is names × buckets, whatever the number of events.
+struct Concurrency
+{
+    Profile::Time       begin   = 0;
+    Profile::Time       bucket  = 1;        // duration of a bucket
+    size_t              buckets = 0;
+    size_t              names   = 0;
+    std::vector<float>  values;             // by name, then bucket
+
+    float               operator()(size_t name, size_t b) const             { return values[name * buckets + b]; }
+    Profile::Time       end() const                                         { return begin + bucket * buckets; }
+    bool                covers(Profile::Time b, Profile::Time e) const      { return buckets && begin <= b && e <= end(); }
+};
+
+// Buckets [begin + i*bucket, begin + (i+1)*bucket), for i in [0, buckets). With innermost, a rank
+// counts only towards the name of its innermost event, so the names add up to the number of busy
+// ranks; otherwise it counts towards every name it's inside (once, if the name is nested in itself).
+// The time is split into slabs of buckets, swept in parallel through difference arrays.
+Concurrency     compute_concurrency(const Profile& profile, Profile::Time begin, Profile::Time bucket, size_t buckets,
+                                    bool innermost = false);
+
+// The same curves with buckets factor times longer, aligned to multiples of the new duration; the begin
+// of concurrency must be a multiple of its bucket. The buckets at the edges only count the covered time.
+Concurrency     coarsen(const Concurrency& concurrency, size_t factor);
+
+}
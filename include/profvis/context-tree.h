@@ -0,0 +1,55 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+#include "profile.h"
+
+namespace profvis
+{
+
+// Calling contexts: the distinct paths of names from the top of the ranks, each stored once,
+// with the times of all the events that have that path.
+struct ContextTree
+{
+    static constexpr size_t     root = 0;
+    static constexpr size_t     none = static_cast<size_t>(-1);
+
+    struct Totals
+    {
+        Profile::Time   inclusive, exclusive;
+        size_t          count;
+    };
+
+    struct RankTotals
+    {
+        size_t          rank;
+        Totals          totals;
+    };
+
+    struct Node
+    {
+        size_t                  name;           // none for the root
+        size_t                  parent;         // none for the root
+        size_t                  depth;
+        Totals                  totals;         // over all the ranks
+        std::vector<size_t>     children;       // sorted by inclusive time, longest first
+        std::vector<RankTotals> ranks;          // only the ranks on which the path occurs, in order
+    };
+
+    // the child of the node with the given name, or none
+    size_t                      child(size_t node, size_t name) const;
+    // names along the path, from the top, joined by separator
+    std::string                 path(const Profile& profile, size_t node, char separator = ';') const;
+
+    std::vector<Node>           nodes;
+};
+
+// One pass over the events; the memory is proportional to the number of distinct paths.
+ContextTree     build_context_tree(const Profile& profile);
+
+// Folded stacks, as read by flamegraph.pl and speedscope: "a;b;c time" per path,
+// with the exclusive time in microseconds, summed over the ranks.
+void            write_folded(const Profile& profile, const ContextTree& tree, std::ostream& out);
+
+}
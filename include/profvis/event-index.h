@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+
+#include "profile.h"
+
+namespace profvis
+{
+
+// Events of every rank, flattened by depth. Events at one depth don't overlap,
+// so the one containing a given time is found by a binary search over the begins.
+struct EventIndex
+{
+    static constexpr size_t     block = 64;
+
+    struct Depth
+    {
+        std::vector<Profile::Time>              begins;
+        std::vector<const Profile::Event*>      events;
+        std::vector<Profile::Time>              sums;       // prefix sums of the durations, one longer than events
+        std::vector<std::vector<Profile::Time>> longest;    // longest duration in blocks of events, then in blocks of those, ...
+
+        // position of the first event at or after i that lasts at least duration, or the number of events;
+        // skips whole blocks of shorter ones
+        size_t                  next_longer(size_t i, Profile::Time duration) const;
+        Profile::Time           duration(size_t i) const    { return events[i]->end - events[i]->begin; }
+    };
+    using Depths = std::vector<Depth>;
+
+    // event of rank rk at the given depth that contains time, or nullptr
+    const Profile::Event*       find(size_t rk, size_t depth, Profile::Time time) const;
+    // time covered by the events of rank rk at the given depth, within [begin, end]
+    Profile::Time               covered(size_t rk, size_t depth, Profile::Time begin, Profile::Time end) const;
+
+    std::vector<Depths>         ranks;
+};
+
+EventIndex      build_event_index(const Profile& profile);
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+#include "profile-canvas.h"
+
+namespace profvis
+{
+
+// Part of the profile to export: the time interval and the ranks (rows of the canvas) [first_rank, last_rank).
+struct ExportWindow
+{
+    Profile::Time   begin, end;
+    size_t          first_rank, last_rank;
+    int             width       = 1600;     // pixels
+    int             height      = 0;        // pixels; 0 for the height of the ranks, up to max_size; the ranks are squeezed to fit
+
+    static constexpr int    max_size    = 8192;     // pixels on a side
+};
+
+// Renders the window with the layout of the canvas into a PNG, or an SVG if fn ends in .svg.
+// Needs no OpenGL context: the rectangles come from ProfileCanvas::collect().
+void
+export_image(ProfileCanvas& canvas, const ExportWindow& window, std::string fn);
+
+}
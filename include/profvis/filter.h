@@ -0,0 +1,75 @@
+#pragma once
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "profile.h"
+
+namespace profvis
+{
+
+// Which events to draw and hit, compiled from an expression such as
+//     name =~ "^MPI_" && duration > 5ms && rank in 0-127 && depth <= 3
+// into a disjunction of conjunctions: each a set of names and a range of
+// durations, ranks, and depths.
+//
+// Terms:       name =~ "regex", name !~ "regex", name == "x", name != "x",
+//              duration|rank|depth  < <= > >= == != value,  rank|depth in a-b,c,...
+// Durations:   microseconds, or with a unit: ns, us, ms, s.
+// Operators:   !, &&, ||, parentheses.
+struct Filter
+{
+    using Value = unsigned long;
+
+    struct Range
+    {
+                        Range(Value lo_ = 0, Value hi_ = std::numeric_limits<Value>::max()):
+                            lo(lo_), hi(hi_)                        {}
+
+        Value           lo, hi;                     // inclusive
+        bool            contains(Value x) const     { return lo <= x && x <= hi; }
+        bool            empty() const               { return hi < lo; }
+    };
+
+    struct Conjunction
+    {
+        std::vector<bool>   names;                  // by id
+        Range               duration, rank, depth;
+    };
+
+    bool                operator()(size_t rank, size_t depth, size_t id, Profile::Time duration) const
+    {
+        if (all)
+            return true;
+        if (!any_name[id])
+            return false;
+        for (auto& c : conjunctions)
+            if (c.names[id] && c.rank.contains(rank) && c.depth.contains(depth) && c.duration.contains(duration))
+                return true;
+        return false;
+    }
+
+    // whether some duration would pass; for summaries that don't know the durations of their events
+    bool                may_match(size_t rank, size_t depth, size_t id) const
+    {
+        if (all)
+            return true;
+        if (!any_name[id])
+            return false;
+        for (auto& c : conjunctions)
+            if (c.names[id] && c.rank.contains(rank) && c.depth.contains(depth))
+                return true;
+        return false;
+    }
+
+    bool                        all = true;         // no expression, everything passes
+    std::vector<Conjunction>    conjunctions;
+    std::vector<bool>           any_name;           // union of the names of the conjunctions
+};
+
+// Throws std::runtime_error if the expression doesn't parse, or expands into too many alternatives;
+// an empty expression passes everything.
+Filter          compile_filter(const Profile& profile, const std::string& expression);
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+namespace profvis
+{
+
+// Work done to draw a frame (or to collect a single view).
+struct FrameStats
+{
+    size_t  visited         = 0;        // events and buckets looked at
+    size_t  rects           = 0;        // rectangles emitted
+    size_t  culled_filter   = 0;        // shorter than time_filter, or merged in the automatic mode
+    size_t  culled_hidden   = 0;        // hidden or filtered out
+    size_t  culled_view     = 0;        // outside the view, skipped without being looked at
+    size_t  draw_calls      = 0;        // fills and texts
+    double  time            = 0;        // milliseconds
+};
+
+// Rolling window of frame times.
+class FrameTimes
+{
+    public:
+                            FrameTimes(size_t size = 240):
+                                times_(size)                                {}
+
+        void                add(float ms)                                   { times_[next_] = ms; next_ = (next_ + 1) % times_.size(); count_ = std::min(count_ + 1, times_.size()); }
+
+        size_t              size() const                                    { return count_; }
+        float               max() const                                     { return count_ ? *std::max_element(times_.begin(), times_.begin() + count_) : 0; }
+
+        // counts of the times in [0, range), in equal bins; longer frames go into the last bin
+        std::vector<size_t> histogram(size_t bins, float range) const
+        {
+            std::vector<size_t> counts(bins, 0);
+            for (size_t i = 0; i < count_; ++i)
+                ++counts[std::min<size_t>(times_[i] / range * bins, bins - 1)];
+            return counts;
+        }
+
+    private:
+        std::vector<float>  times_;
+        size_t              next_  = 0;
+        size_t              count_ = 0;
+};
+
+}
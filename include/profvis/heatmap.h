@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "profile.h"
+
+namespace profvis
+{
+
+// Ranks by time, one value per pixel. Each row aggregates consecutive ranks
+// (in the given order, if any), when there are more ranks than rows.
+struct Heatmap
+{
+    static constexpr size_t     dominant = static_cast<size_t>(-1);
+
+    size_t                      columns = 0;
+    size_t                      rows    = 0;
+    std::vector<std::uint32_t>  ids;            // dominant name of each pixel, row-major (only in the dominant mode)
+    std::vector<float>          values;         // fraction of the pixel covered by events, or by the selected name
+};
+
+// With name == Heatmap::dominant, the pixels record the name that dominates them at the given depth;
+// otherwise, the fraction of their time spent in the name (at any depth).
+Heatmap         compute_heatmap(const Profile& profile, Profile::Time begin, Profile::Time end,
+                                size_t columns, size_t rows, size_t depth, size_t name = Heatmap::dominant,
+                                const std::vector<size_t>& order = std::vector<size_t>());
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "profile.h"
+
+namespace profvis
+{
+
+// Multi-resolution summary of the events: for every rank and depth, a pyramid
+// of equal-width time buckets, each recording the name that dominates it and
+// the fraction of its time covered by events. Level 0 is the finest; every
+// next level merges `fanout` buckets of the previous one.
+struct LevelOfDetail
+{
+    struct Bucket
+    {
+        static constexpr std::uint32_t  empty = static_cast<std::uint32_t>(-1);
+
+                        Bucket(std::uint32_t id_ = empty, float busy_ = 0):
+                            id(id_), busy(busy_)                {}
+
+        std::uint32_t   id;                     // dominant name
+        float           busy;                   // fraction of the bucket covered by events
+    };
+    using Buckets = std::vector<Bucket>;
+    using Levels  = std::vector<Buckets>;
+
+    struct Rank
+    {
+        Profile::Time           width = 1;      // width of a level 0 bucket
+        std::vector<Levels>     depths;
+    };
+
+    static constexpr size_t     fanout = 4;
+
+    // coarsest level whose buckets are no wider than time_per_pixel; -1 if even level 0 is too coarse
+    int                         level(size_t rk, double time_per_pixel) const;
+    Profile::Time               width(size_t rk, int level) const;
+
+    std::vector<Rank>           ranks;
+    Profile::Time               min_time = 0;
+};
+
+LevelOfDetail   build_lod(const Profile& profile);
+
+}
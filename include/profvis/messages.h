@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "profile.h"
+
+namespace profvis
+{
+
+// Matched point-to-point messages, as a pyramid of levels for drawing: level 0 has every message,
+// each coarser level bundles the messages between the same two ranks sent within longer buckets.
+struct Messages
+{
+    // A message, or a bundle of count of them with their mean times.
+    struct Flow
+    {
+        std::uint32_t   src, dst;
+        Profile::Time   send, recv;         // begin of the send, end of the receive
+        std::uint32_t   count;
+    };
+
+    struct Level
+    {
+        Profile::Time               bucket;     // 0 for the messages themselves
+        std::vector<Flow>           flows;      // by send time
+        std::vector<Profile::Time>  reach;      // running maximum of the flows' latest times, to skip the ones that end early
+    };
+
+    // the coarsest level whose buckets are at most the given duration
+    size_t              level(Profile::Time bucket) const
+    {
+        size_t l = 0;
+        while (l + 1 < levels.size() && levels[l + 1].bucket <= bucket)
+            ++l;
+        return l;
+    }
+
+    // calls f(flow) for the flows of the level that overlap [begin, end]
+    template<class F>
+    void                visit(size_t l, Profile::Time begin, Profile::Time end, const F& f) const
+    {
+        auto& level = levels[l];
+        size_t i = std::partition_point(level.reach.begin(), level.reach.end(),
+                                        [begin](Profile::Time t) { return t < begin; }) - level.reach.begin();
+        for (; i < level.flows.size() && level.flows[i].send <= end; ++i)
+            if (std::max(level.flows[i].send, level.flows[i].recv) >= begin)
+                f(level.flows[i]);
+    }
+
+    std::vector<Level>  levels;
+    size_t              unmatched = 0;      // sends and receives without a partner
+};
+
+// Pairs the k-th send from a rank to another with a tag with the k-th matching receive (MPI's
+// non-overtaking order; wildcards and communicators aren't recorded). The endpoints are hashed
+// by (source, destination, tag) into shards that are matched in parallel.
+Messages        match_messages(const Profile& profile);
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <nanogui/widget.h>
+#include <nanogui/textbox.h>
+
+#include "profile-canvas.h"
+
+namespace profvis
+{
+
+// Names sorted by their total time, drawn directly: only the rows in view cost anything,
+// however many names the profile has.
+class NameList: public nanogui::Widget
+{
+    public:
+        using Callback = std::function<void(size_t)>;
+
+        static constexpr size_t none = -1;
+
+    public:
+                                NameList(nanogui::Widget* parent, ProfileCanvas* canvas, const std::vector<Profile::Time>& totals);
+
+        // show only the names that contain s, ignoring case
+        void                    set_search(const std::string& s);
+
+        void                    set_callback(const Callback& callback)              { callback_ = callback; }
+        size_t                  selected() const                                    { return selected_; }
+
+        virtual void            draw(NVGcontext* ctx) override;
+        virtual nanogui::Vector2i   preferredSize(NVGcontext* ctx) const override   { return { 320, rows * row_height }; }
+        virtual bool            mouseButtonEvent(const nanogui::Vector2i &p, int button, bool down, int modifiers) override;
+        virtual bool            scrollEvent(const nanogui::Vector2i &p, const nanogui::Vector2f &rel) override;
+
+    public:
+        int                     row_height  = 20;
+        int                     rows        = 20;
+
+    private:
+        float                   max_scroll() const                                  { return std::max(0.f, float(long(shown_.size()) * row_height) - mSize.y()); }
+
+    private:
+        ProfileCanvas*                      canvas_;
+        const std::vector<Profile::Time>&   totals_;
+        std::vector<size_t>                 order_;         // by total time, longest first
+        std::vector<size_t>                 shown_;         // the names of order_ that match the search
+        float                               scroll_     = 0;
+        size_t                              selected_   = none;
+        Callback                            callback_;
+};
+
+// Text box that reports every edit, not only the committed value.
+class SearchBox: public nanogui::TextBox
+{
+    public:
+        using Callback = std::function<void(const std::string&)>;
+
+    public:
+                                SearchBox(nanogui::Widget* parent):
+                                    nanogui::TextBox(parent, ""), search_([](const std::string&) {})
+                                {
+                                    setEditable(true);
+                                    setPlaceholder("search");
+                                    setAlignment(Alignment::Left);
+                                }
+
+        void                    set_search_callback(const Callback& callback)       { search_ = callback; }
+
+        virtual bool            keyboardEvent(int key, int scancode, int action, int modifiers) override
+        {
+            bool result = nanogui::TextBox::keyboardEvent(key, scancode, action, modifiers);
+            search_(mValueTemp);
+            return result;
+        }
+
+        virtual bool            keyboardCharacterEvent(unsigned int codepoint) override
+        {
+            bool result = nanogui::TextBox::keyboardCharacterEvent(codepoint);
+            search_(mValueTemp);
+            return result;
+        }
+
+    private:
+        Callback                search_;
+};
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "profile.h"
+#include "event-index.h"
+
+namespace profvis
+{
+
+// Every event, grouped by name; within a name sorted by begin, and separately by duration.
+struct Occurrences
+{
+    struct Occurrence
+    {
+        Profile::Time   begin, duration;
+        std::uint32_t   rank, depth;
+        std::uint32_t   index;              // in EventIndex::ranks[rank][depth]
+    };
+
+    size_t                      first(size_t name) const            { return offsets[name]; }
+    size_t                      last(size_t name) const             { return offsets[name + 1]; }
+    size_t                      count(size_t name) const            { return last(name) - first(name); }
+
+    // position of the first occurrence of the name that begins at or after time; last(name) if there is none
+    size_t                      first_after(size_t name, Profile::Time time) const;
+
+    std::vector<size_t>         offsets;            // occurrences of name i are [offsets[i], offsets[i+1])
+    std::vector<Occurrence>     by_begin;
+    std::vector<size_t>         by_duration;        // positions in by_begin, longest first within each name
+};
+
+Occurrences     build_occurrences(const Profile& profile, const EventIndex& index);
+
+}
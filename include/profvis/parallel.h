@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace profvis
+{
+
+// Calls f(i) for every i in [0,n), spreading the calls over the hardware threads.
+template<class F>
+void            parallel_for(size_t n, const F& f)
+{
+    size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), n);
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < n; ++i)
+            f(i);
+        return;
+    }
+
+    std::atomic<size_t>         next(0);
+    std::vector<std::thread>    workers;
+    for (size_t t = 0; t < threads; ++t)
+        workers.emplace_back([&next,n,&f]()
+        {
+            for (size_t i = next++; i < n; i = next++)
+                f(i);
+        });
+
+    for (auto& w : workers)
+        w.join();
+}
+
+}
@@ -1,9 +1,23 @@
 #pragma once
 
 #include <random>
+#include <unordered_map>
+#include <chrono>
 
 #include "canvas.h"
 #include "profile.h"
+#include "lod.h"
+#include "event-index.h"
+#include "region.h"
+#include "occurrences.h"
+#include "filter.h"
+#include "rank-order.h"
+#include "rect-batches.h"
+#include "heatmap.h"
+#include "concurrency.h"
+#include "collectives.h"
+#include "messages.h"
+#include "frame-stats.h"
 
 namespace profvis
 {
@@ -19,53 +33,221 @@ class ProfileCanvas: public Canvas
     public:
         using Hide      = std::vector<bool>;
         using Callback  = std::function<void(const Profile::Event&,int)>;
+        using SelectionCallback = std::function<void(const Region&)>;
 
     public:
                                 ProfileCanvas(const Profile& profile, nanogui::Widget* parent):
                                     Canvas(parent),
                                     profile_(profile),
                                     colors_(name_to_color(profile_)),
+                                    lod_(build_lod(profile_)),
+                                    index_(build_event_index(profile_)),
+                                    regions_(build_region_index(profile_)),
+                                    occurrences_(build_occurrences(profile_, index_)),
+                                    messages_(match_messages(profile_)),
+                                    batches_(profile_.names.size()),
+                                    overview_(compute_heatmap(profile_, profile_.min_time(), profile_.max_time(),
+                                                              overview_columns, overview_rows, 0)),
                                     hide(profile_.names.size(), false),
-                                    callback_([](const Profile::Event&,int) {})
-                                {}
+                                    callback_([](const Profile::Event&,int) {}),
+                                    selection_callback_([](const Region&) {})
+                                {
+                                    set_order(rank_order(rank_metric(profile_, RankMetric::Number), false));
+                                }
+        virtual void            draw(NVGcontext* ctx) override;
         virtual void            drawContents(NVGcontext* ctx) override;
+        virtual void            drawOverlay(NVGcontext* ctx) override;
         virtual ng::Vector2i    preferredSize(NVGcontext *ctx) const override       { return mParent->size(); }
 
-        void                    draw_events(NVGcontext* ctx, const Profile::Events& events, size_t hoffset, size_t voffset, size_t height);
+        // collect the rectangles of the rows [first_row, last_row) inside the view; used by drawContents() and the exports
+        RectBatches&            collect(const View& view, size_t first_row, size_t last_row);
+        // collect the rectangles into batches_
+        void                    draw_events(const Profile::Events& events, size_t rk, size_t depth, size_t hoffset, size_t voffset, size_t height);
+        void                    draw_lod(size_t rk, int level, size_t hoffset, size_t voffset, size_t height);
+        // fill the collected rectangles, one path per colour
+        void                    draw_batches(NVGcontext* ctx);
+        // labels of the events wide enough for one, over the whole view; drawn on top of the tiles
+        void                    draw_labels(NVGcontext* ctx);
+        void                    collect_labels(const View& region);
+        const std::string&      label(NVGcontext* ctx, size_t id, float available);
+        void                    draw_ranks(NVGcontext* ctx);                        // counts of the ranks outside the view
+        void                    draw_heatmap(NVGcontext* ctx);
+        void                    draw_overview(NVGcontext* ctx);
+        void                    draw_concurrency(NVGcontext* ctx);
+        void                    stack_concurrency();                               // into concurrency_areas_
+        void                    draw_messages(NVGcontext* ctx);
+        void                    draw_statistics(NVGcontext* ctx);
+
+        // frame statistics: begin_frame() starts the clock before update_cache(), draw() stops it
+        void                    begin_frame()                                       { stats_ = FrameStats(); frame_start_ = std::chrono::steady_clock::now(); }
+        const FrameStats&       stats() const                                       { return stats_; }
+        void                    reset_stats()                                       { stats_ = FrameStats(); }
+
+        virtual void            damage() override                                   { Canvas::damage(); heatmap_dirty_ = overview_dirty_ = labels_dirty_ = concurrency_dirty_ = true; }
 
         const NameColors&       colors() const                                      { return colors_; }
-        void                    set_color(std::string name, ng::Color c)            { colors_[profile().id(name)] = c; }
+        void                    set_color(std::string name, ng::Color c)            { colors_[profile().id(name)] = c; damage(); }
+
+        void                    toggle(std::string name)                            { auto id = profile().id(name); hide[id] = !hide[id]; damage(); }
+        bool                    hidden(size_t id) const                             { return hide[id]; }
 
-        void                    toggle(std::string name)                            { auto id = profile().id(name); hide[id] = !hide[id]; }
+        // compiles the expression (see Filter), throwing std::runtime_error if it doesn't parse
+        void                    set_filter(const std::string& expression)           { filter_ = compile_filter(profile_, expression); damage(); }
+        const Filter&           filter() const                                      { return filter_; }
+        // the event is neither hidden nor filtered out
+        bool                    shown(size_t rk, size_t depth, const Profile::Event& e) const   { return !hide[e.id] && filter_(rk, depth, e.id, e.end - e.begin); }
 
         void                    randomize_colors();
 
         void                    set_callback(const Callback& callback)              { callback_ = callback; }
+        void                    set_selection_callback(const SelectionCallback& callback)   { selection_callback_ = callback; }
+
+        // stretches of ranks to outline, in time order, e.g. Collectives::critical_path
+        void                    set_path(std::vector<Collectives::Segment> path)    { path_ = std::move(path); }
+
+        const Messages&         matched_messages() const                            { return messages_; }
+        const Occurrences&      occurrences() const                                 { return occurrences_; }
+        const Profile::Event&   event(const Occurrences::Occurrence& o) const      { return *index_.ranks[o.rank][o.depth].events[o.index]; }
+        // centres the view on the occurrence, zooming if it's too wide or too narrow to see, and outlines it
+        void                    focus(const Occurrences::Occurrence& o);
+        Profile::Time           center_time() const;
+
+        // statistics of the names in the selected time range and ranks
+        virtual void            select(nanogui::Vector2f min, nanogui::Vector2f max) override;
 
+        virtual bool            mouseButtonEvent(const nanogui::Vector2i &p, int button, bool down, int modifiers) override;
         virtual bool            mouseMotionEvent(const nanogui::Vector2i &p, const nanogui::Vector2i &rel, int button, int modifiers) override;
-        const Profile::Event*   search_events(Profile::Time time, const Profile::Events& events, int level, int max_level) const;
+        // deepest event of the rank, down to max_level, that contains time and is drawn (passes time_filter and isn't hidden)
+        const Profile::Event*   search_events(Profile::Time time, size_t rk, int max_level) const;
 
         size_t                  base_height() const                                 { return init_height + 2*inset*profile_.max_depth(); }
+        float                   time_to_x(Profile::Time t) const                    { return init_hoffset + (double(t) - profile_.min_time()) / (profile_.max_time() - profile_.min_time()) * width; }
+        float                   row_to_y(size_t row) const                          { return init_voffset + (base_height() + rank_gap)*row; }
+        float                   rank_to_y(size_t rk) const                          { return row_to_y(row_of_[rk]); }
+
+        // ranks are drawn in rows, in the order of a permutation; the events stay where they are
+        void                    set_order(std::vector<size_t> order);
+        void                    sort_ranks(RankMetric metric, size_t name, bool descending)     { set_order(rank_order(rank_metric(profile_, metric, name), descending)); }
+        size_t                  rank_at(size_t row) const                           { return order_[row]; }
+        size_t                  row_of(size_t rk) const                             { return row_of_[rk]; }
 
         const Profile&          profile() const                                     { return profile_; }
 
     public:
         size_t                  time_filter     = 1000;
+        bool                    auto_filter     = false;    // merge events narrower than a pixel instead of applying time_filter
         size_t                  width           = 1000;
         size_t                  init_height     = 30;
         size_t                  inset           = 5;
         size_t                  rank_gap        = 30;
+        bool                    level_of_detail = true;
+        bool                    labels          = true;
+        float                   label_width     = 40;       // narrowest rectangle (in pixels) that gets a label
+        float                   label_font_size = 12;
+        bool                    heatmap         = false;    // one pixel per rank and time bucket, instead of the timeline
+        size_t                  heatmap_depth   = 0;
+        size_t                  heatmap_name    = Heatmap::dominant;    // or the name whose fraction of time is shown
+        bool                    overview        = true;     // strip with the whole run at the bottom
+        float                   overview_height = 40;
+        bool                    statistics      = false;    // frame time and counters in the corner
+        bool                    concurrency     = false;    // strip at the top with the ranks inside each name, stacked
+        float                   concurrency_height = 60;
+        bool                    messages        = true;     // arrows from sends to the matching receives
 
     private:
         const Profile&          profile_;
         NameColors              colors_;
+        LevelOfDetail           lod_;
+        EventIndex              index_;
+        RegionIndex             regions_;
+        Occurrences             occurrences_;
+        Messages                messages_;
+        Filter                  filter_;
+
+        bool                    focused_        = false;
+        Occurrences::Occurrence focus_;
+        void                    draw_focus(NVGcontext* ctx);
+
+        std::vector<Collectives::Segment>   path_;
+        void                    draw_path(NVGcontext* ctx);
+        RectBatches             batches_;
+
+        struct Label
+        {
+            float   x, y, w, h;
+            size_t  id;
+        };
+        std::vector<Label>                          labels_;                // of labels_region_, at labels_scale_
+        View                                        labels_region_;
+        ng::Vector2f                                labels_scale_   = ng::Vector2f(0, 0);
+        bool                                        labels_dirty_   = true;
+        std::unordered_map<size_t, std::string>     truncated_labels_;      // by name id and available width
+
+        Heatmap                 heatmap_;
+        Profile::Time           heatmap_begin_  = 0;
+        Profile::Time           heatmap_end_    = 0;
+        bool                    heatmap_dirty_  = true;
+        std::vector<unsigned char>  heatmap_pixels_;
+        int                     heatmap_image_  = -1;
+
+        void                    colorize(const Heatmap& h, size_t name, std::vector<unsigned char>& pixels) const;
+        void                    upload_image(NVGcontext* ctx, int& image, const Heatmap& h, const std::vector<unsigned char>& pixels);
+
+        // overview of the whole run, computed once
+        static constexpr size_t overview_columns = 1024;
+        static constexpr size_t overview_rows    = 32;
+        Heatmap                 overview_;
+        bool                    overview_dirty_ = true;
+        std::vector<unsigned char>  overview_pixels_;
+        int                     overview_image_ = -1;
+
+        // curves of the visible time range, with a margin; recomputed when the view leaves it or zooms in,
+        // merged into longer buckets when it zooms out
+        Concurrency             concurrency_;
+
+        // the stacked areas of the strip, in pixels, for the view they were built for; redrawn as they are until it changes
+        struct Area
+        {
+            size_t                      id;
+            std::vector<ng::Vector2f>   outline;
+        };
+        std::vector<Area>       concurrency_areas_;
+        std::array<float, 5>    concurrency_view_ {{ 0, 0, 0, 0, 0 }};     // scale, translation, position, width, height
+        bool                    concurrency_dirty_  = true;
+
+        // brushing the overview sets the time range of the view
+        enum class Brush { None, Move, Draw };
+        void                    brush(float& begin, float& end) const;
+        void                    set_brush(float begin, float end);
+        bool                    in_overview(const nanogui::Vector2i& p) const;
+
+        Brush                   brush_          = Brush::None;
+        float                   brush_anchor_   = 0;
+        float                   brush_begin_    = 0;
+        float                   brush_end_      = 0;
 
         size_t                  init_voffset    = 30;
         size_t                  init_hoffset    = 30;
 
         Hide                    hide;
 
+        Profile::Time           view_begin_     = 0;        // visible time interval, set by drawContents()
+        Profile::Time           view_end_       = 0;
+        Profile::Time           pixel_time_     = 0;        // duration of a pixel, set by drawContents()
+
+        size_t                  rank_margin     = 2;        // extra ranks drawn above and below the view
+
+        std::vector<size_t>     order_;                     // rank in each row
+        std::vector<size_t>     row_of_;                    // row of each rank
+        std::vector<size_t>     row_events_;                // top-level events in the rows before each row
+
+        FrameStats              stats_;                     // of the frame being drawn
+        FrameStats              last_stats_;                // of the previous frame, shown by draw_statistics()
+        FrameTimes              frame_times_;
+        std::chrono::steady_clock::time_point   frame_start_;
+
         Callback                callback_;
+        SelectionCallback       selection_callback_;
 };
 
 NameColors
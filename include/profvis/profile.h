@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <fstream>
@@ -23,10 +24,28 @@ struct Profile
         size_t          id;
         Time            begin;
         Time            end;
+        Time            exclusive;      // not spent in the children; filled in by compute_times()
 
         Events          events;
     };
 
+    // Side of a point-to-point message: a send or a receive call, with its peer and tag,
+    // from caliper's mpi.msg.* attributes or from key=value pairs in a .prf.
+    struct Endpoint
+    {
+        std::uint32_t   rank, peer;
+        std::int32_t    tag;
+        bool            send;
+        Time            begin, end;
+    };
+
+    // Time in a name; a name nested in itself counts its inclusive time once.
+    struct Times
+    {
+        Time            inclusive;
+        Time            exclusive;
+    };
+
     int                 max_depth() const   { return max_depth_; }
     Time                max_time() const    { return max_time_; }
     Time                min_time() const    { return min_time_; }
@@ -36,18 +55,39 @@ struct Profile
 
     size_t              id(std::string name) const      { return ids.find(name)->second; }
 
+    // Times of a name on a rank.
+    struct RankTimes
+    {
+        size_t          id;
+        Times           times;
+    };
+
+    const Times&        times(size_t id) const              { return times_[id]; }      // over all ranks
+    const Times&        times(size_t rk, size_t id) const;                              // zero if the name isn't on the rank
+
     std::vector<Events>                         events;     // one per rank
     std::vector<std::string>                    names;
     std::unordered_map<std::string,size_t>      ids;
+    std::vector<Endpoint>                       endpoints;
 
     int                         max_depth_;
     Time                        max_time_;
     Time                        min_time_;
+    std::vector<Times>                      times_;         // per name
+    std::vector<std::vector<RankTimes>>     rank_times_;    // per rank, the names on it, by id
 };
 
 Profile::Time   parse_time(std::string stamp);
+Profile::Time   parse_time(const char* stamp);
 Profile         read_profile(std::string fn);
 
 Profile         read_caliper(std::string fn, bool mpi_functions = false);
 
+// Fills in Event::exclusive and the times of the names, in parallel over the ranks; the readers call it.
+void            compute_times(Profile& profile);
+
+// Time spent in each name, over all ranks; a name nested in itself is counted once.
+std::vector<Profile::Time>
+total_times(const Profile& profile);
+
 }
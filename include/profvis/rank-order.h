@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+
+#include "profile.h"
+
+namespace profvis
+{
+
+enum class RankMetric
+{
+    Number,         // the rank itself
+    NameTime,       // time in a given name
+    MPITime,        // time in the names that start with MPI_
+    LastEnd,        // end of the last event
+    Count,          // number of events
+};
+
+// The metric for every rank, computed in parallel; name is used only by RankMetric::NameTime.
+std::vector<double>     rank_metric(const Profile& profile, RankMetric metric, size_t name = 0);
+
+// Ranks ordered by the metric; ties keep the numeric order.
+std::vector<size_t>     rank_order(const std::vector<double>& metric, bool descending);
+
+}
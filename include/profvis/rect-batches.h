@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace profvis
+{
+
+// Rectangles grouped by depth, name, and opacity, so that each group is filled
+// with a single path. Buffers are kept between frames; clear() only empties them.
+class RectBatches
+{
+    public:
+        struct Rect { float x, y, w, h; };
+        struct Mixed
+        {
+            Rect    rect;
+            float   color[4];       // colours of the merged events, weighted by their duration
+        };
+
+        static constexpr size_t shades = 8;         // opacity levels
+        static constexpr size_t levels = 8;         // per colour channel of the merged rectangles
+
+    public:
+                            RectBatches(size_t names = 0):
+                                names_(names)                               {}
+
+        void                add(size_t depth, size_t id, float alpha, const Rect& r)
+        {
+            size_t key   = (depth * names_ + id) * shades + shade(alpha);
+            if (key >= rects_.size())
+                rects_.resize(key + 1);
+            if (rects_[key].empty())
+                used_.push_back(key);
+            rects_[key].push_back(r);
+        }
+
+        // merged sub-pixel events; their colours are quantized, so that the rectangles of the same
+        // colour are filled with a single path too. They overlap nothing, so they go last.
+        void                add_mixed(const Mixed& m)
+        {
+            size_t key = shade(m.color[3]);
+            for (size_t c = 0; c < 3; ++c)
+                key = key * levels + std::min<long>(std::max<long>(std::lround(m.color[c] * (levels - 1)), 0), levels - 1);
+            if (key >= mixed_.size())
+                mixed_.resize(key + 1);
+            if (mixed_[key].empty())
+                mixed_used_.push_back(key);
+            mixed_[key].push_back(m.rect);
+        }
+
+        // calls f(id, alpha, rects) for every group, shallower depths first
+        template<class F>
+        void                for_each(const F& f)
+        {
+            std::sort(used_.begin(), used_.end());
+            for (size_t key : used_)
+                f((key / shades) % names_, float(key % shades + 1) / shades, rects_[key]);
+        }
+
+        // calls f(color, rects) for every colour of the merged rectangles
+        template<class F>
+        void                for_each_mixed(const F& f)
+        {
+            for (size_t key : mixed_used_)
+            {
+                float color[4];
+                size_t k = key;
+                for (size_t c = 3; c-- > 0; k /= levels)
+                    color[c] = float(k % levels) / (levels - 1);
+                color[3] = float(k + 1) / shades;
+                f(color, mixed_[key]);
+            }
+        }
+
+        void                clear()
+        {
+            for (size_t key : used_)
+                rects_[key].clear();
+            used_.clear();
+            for (size_t key : mixed_used_)
+                mixed_[key].clear();
+            mixed_used_.clear();
+        }
+
+        size_t              groups() const                                  { return used_.size() + mixed_used_.size(); }
+
+    private:
+        static size_t       shade(float alpha)                              { return std::min<long>(std::max<long>(std::lround(alpha * shades) - 1, 0), shades - 1); }
+
+    private:
+        size_t                              names_;
+        std::vector<std::vector<Rect>>      rects_;
+        std::vector<size_t>                 used_;
+        std::vector<std::vector<Rect>>      mixed_;         // by quantized colour
+        std::vector<size_t>                 mixed_used_;
+};
+
+}
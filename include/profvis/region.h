@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "profile.h"
+#include "event-index.h"
+
+namespace profvis
+{
+
+// Occurrences of every name in every rank, sorted by begin, with prefix sums of their
+// inclusive and exclusive times and the extremes of their durations in blocks, so that
+// the statistics of a time range take a couple of binary searches per name and rank.
+struct RegionIndex
+{
+    struct Rank
+    {
+        std::vector<std::uint32_t>  ids;            // names present in the rank, ascending
+        std::vector<size_t>         offsets;        // occurrences of ids[i] are [offsets[i], offsets[i+1])
+        std::vector<Profile::Time>  begins;         // by name, then by begin
+        std::vector<Profile::Time>  durations;
+        std::vector<Profile::Time>  totals;         // prefix sums of durations, one longer
+        std::vector<Profile::Time>  inclusive;      // the same, of the outermost occurrences only (not nested in the name)
+        std::vector<Profile::Time>  exclusive;      // prefix sums of the time not spent in children, one longer
+        std::vector<Profile::Time>  block_min;      // of durations, per block
+        std::vector<Profile::Time>  block_max;
+    };
+
+    static constexpr size_t     block = 64;
+
+    std::vector<Rank>           ranks;
+};
+
+RegionIndex     build_region_index(const Profile& profile);
+
+struct NameStats
+{
+    Profile::Time   inclusive   = 0;        // clipped to the region; a name nested in itself counts once
+    Profile::Time   exclusive   = 0;
+    size_t          count       = 0;        // events that begin in the region, counted whole
+    Profile::Time   total       = 0;        // their duration
+    Profile::Time   min         = std::numeric_limits<Profile::Time>::max();
+    Profile::Time   max         = 0;
+
+    double          mean() const        { return count ? double(total) / count : 0; }
+};
+
+struct Region
+{
+    Profile::Time   begin, end;
+    std::vector<size_t>                         ranks;
+    std::vector<std::pair<size_t, NameStats>>   names;      // by inclusive time, longest first
+};
+
+// Statistics of every name over [begin, end) and the given ranks.
+Region          region_stats(const RegionIndex& regions, const EventIndex& events,
+                             Profile::Time begin, Profile::Time end, std::vector<size_t> ranks);
+
+}
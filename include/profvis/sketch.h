@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include "profile.h"
+
+namespace profvis
+{
+
+// Log-bucketed histogram of durations, in the style of HDR histograms: every power of two is split
+// into 2^sub_bits equal buckets, so a quantile is off by less than 1/2^sub_bits of its value.
+// The buckets only grow up to the largest duration (under 2^sub_bits buckets per bit of it),
+// and sketches of disjoint sets of events merge by adding their counts.
+class DurationSketch
+{
+    public:
+        using Time = Profile::Time;
+
+        static constexpr unsigned   sub_bits = 5;
+
+        void                add(Time duration);
+        void                merge(const DurationSketch& other);
+
+        size_t              count() const                       { return count_; }
+        Time                min() const                         { return count_ ? min_ : 0; }
+        Time                max() const                         { return max_; }
+
+        // the duration below which a fraction q of the events fall, q in [0,1]
+        Time                quantile(double q) const;
+
+        // counts of the durations in bins spaced logarithmically between min() and max()
+        std::vector<float>  histogram(size_t bins) const;
+
+        static size_t       bucket(Time duration);
+        static Time         lower(size_t bucket);               // smallest duration in the bucket
+        static Time         upper(size_t bucket);               // largest duration in the bucket
+
+    private:
+        std::vector<size_t> counts_;
+        size_t              count_  = 0;
+        Time                min_    = 0;
+        Time                max_    = 0;
+};
+
+// One sketch per name, over all ranks. The ranks are sketched in parallel and then merged.
+std::vector<DurationSketch>     duration_sketches(const Profile& profile);
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "profile.h"
+#include "sketch.h"
+
+namespace profvis
+{
+
+// Which names to count; with neither a segment nor a regex, every name is counted.
+struct StatsOptions
+{
+    std::string     segment;                // count only this name
+    std::string     regex;                  // count the names that match it (at the start, like Python's re.match)
+    bool            full_name   = false;    // use the names of the whole stack, joined with ':'
+    size_t          threads     = 0;        // 0 means the hardware concurrency
+};
+
+struct SegmentStats
+{
+    struct Rank
+    {
+        size_t          count   = 0;
+        Profile::Time   time    = 0;
+        bool            timed   = false;    // some occurrence has ended
+    };
+
+    std::map<int, Rank>     ranks;
+    DurationSketch          durations;      // of the ended occurrences, over all ranks
+};
+
+struct ProfileStats
+{
+    std::map<std::string, SegmentStats>     segments;
+    bool                                    unbalanced = false;     // some stack is not empty at the end
+};
+
+// Counts the occurrences and the time of the names in a .prf file (possibly gzipped) in a single
+// streaming pass: the lines go, by rank, to worker threads through bounded queues, so the memory
+// does not grow with the size of the file.
+ProfileStats    compute_stats(std::string fn, const StatsOptions& options);
+
+// hours:minutes:seconds.microseconds, the inverse of parse_time()
+std::string     format_time(Profile::Time time);
+
+}
@@ -0,0 +1,61 @@
+#include <profvis/benchmark.h>
+
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+#include <fmt/format.h>
+
+void
+profvis::
+benchmark(ProfileCanvas& canvas, size_t repeats, int width, int height)
+{
+    auto&   profile = canvas.profile();
+    double  range   = profile.max_time() - profile.min_time();
+    double  middle  = profile.min_time() + range / 2;
+
+    fmt::print("{:>8} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10}\n",
+               "zoom", "min ms", "mean ms", "visited", "rects", "filter", "hidden", "view", "draw calls");
+
+    FrameStats total;
+    for (double zoom = 1; range / zoom >= 1; zoom *= 10)
+    {
+        Profile::Time begin = middle - range / zoom / 2;
+        Profile::Time end   = middle + range / zoom / 2;
+
+        float x0 = canvas.time_to_x(begin), x1 = canvas.time_to_x(end);
+        Canvas::View view;
+        view.min   = nanogui::Vector2f(x0, 0);
+        view.max   = nanogui::Vector2f(x1, height);
+        view.scale = nanogui::Vector2f(width / (x1 - x0), 1);
+
+        double min_time = std::numeric_limits<double>::max(), sum = 0;
+        for (size_t r = 0; r < std::max<size_t>(repeats, 1); ++r)
+        {
+            canvas.reset_stats();
+            auto start = std::chrono::steady_clock::now();
+            canvas.collect(view, 0, profile.events.size()).clear();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            min_time = std::min(min_time, ms);
+            sum     += ms;
+        }
+        double mean = sum / std::max<size_t>(repeats, 1);
+
+        auto& s = canvas.stats();
+        fmt::print("{:>8} {:>10.3f} {:>10.3f} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10}\n",
+                   zoom, min_time, mean, s.visited, s.rects, s.culled_filter, s.culled_hidden, s.culled_view, s.draw_calls);
+
+        total.time          += mean;
+        total.visited       += s.visited;
+        total.rects         += s.rects;
+        total.culled_filter += s.culled_filter;
+        total.culled_hidden += s.culled_hidden;
+        total.culled_view   += s.culled_view;
+        total.draw_calls    += s.draw_calls;
+    }
+
+    fmt::print("{:>8} {:>10} {:>10.3f} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10}\n",
+               "total", "", total.time, total.visited, total.rects,
+               total.culled_filter, total.culled_hidden, total.culled_view, total.draw_calls);
+}
@@ -1,5 +1,36 @@
 #include <profvis/canvas.h>
 
+#define NANOVG_GL3 1
+#include <nanovg_gl.h>
+#define NANOVG_GL_IMPLEMENTATION 1
+#include <nanovg_gl_utils.h>
+
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+
+// Splits the translation into a whole pixel origin and a phase, in 1/64 of a pixel.
+void
+split(float t, int& origin, int& phase)
+{
+    long p = std::lround(t * 64);
+    origin = std::floor(p / 64.);
+    phase  = p - 64l * origin;
+}
+
+}
+
+constexpr int   profvis::Canvas::tile_size;
+
+profvis::
+Canvas::
+~Canvas()
+{
+    clear_tiles();
+}
+
 void
 profvis::
 Canvas::
@@ -10,6 +41,65 @@ transform(NVGcontext* ctx) const
                  mTransform[3], mTransform[4], mTransform[5]);
 }
 
+profvis::Canvas::View
+profvis::
+Canvas::
+view(const std::array<float,6>& xform, nanogui::Vector2i pos, nanogui::Vector2i size) const
+{
+    std::array<float,6> inverse;
+    nvgTransformInverse(&inverse[0], &xform[0]);
+
+    View v;
+    nvgTransformPoint(&v.min[0], &v.min[1], &inverse[0], pos.x(), pos.y());
+    nvgTransformPoint(&v.max[0], &v.max[1], &inverse[0], pos.x() + size.x(), pos.y() + size.y());
+    v.scale = nanogui::Vector2f(xform[0], xform[3]);
+
+    return v;
+}
+
+void
+profvis::
+Canvas::
+render(NVGcontext* ctx, const std::array<float,6>& xform, nanogui::Vector2i pos, nanogui::Vector2i size)
+{
+    NVGcontext* vg = ctx;
+    nvgSave(vg);
+
+    mView = view(xform, pos, size);
+
+    nvgTransform(vg, xform[0], xform[1], xform[2], xform[3], xform[4], xform[5]);
+    drawContents(vg);
+
+    nvgRestore(vg);
+}
+
+profvis::Canvas::TileKey
+profvis::
+Canvas::
+tile_key(int i, int j) const
+{
+    int origin_x, origin_y;
+    TileKey key { mTransform[0], mTransform[3], 0, 0, i, j };
+    split(mTransform[4], origin_x, key.phase_x);
+    split(mTransform[5], origin_y, key.phase_y);
+    return key;
+}
+
+void
+profvis::
+Canvas::
+visible_tiles(int margin, nanogui::Vector2i& first, nanogui::Vector2i& last) const
+{
+    int origin_x, origin_y, phase;
+    split(mTransform[4], origin_x, phase);
+    split(mTransform[5], origin_y, phase);
+
+    first = { int(std::floor(double(mPos.x() - origin_x) / tile_size)) - margin,
+              int(std::floor(double(mPos.y() - origin_y) / tile_size)) - margin };
+    last  = { int(std::floor(double(mPos.x() + mSize.x() - 1 - origin_x) / tile_size)) + margin,
+              int(std::floor(double(mPos.y() + mSize.y() - 1 - origin_y) / tile_size)) + margin };
+}
+
 void
 profvis::
 Canvas::
@@ -21,12 +111,167 @@ draw(NVGcontext* ctx)
         return;
 
     NVGcontext* vg = ctx;
-    nvgSave(vg);
 
-    Canvas::transform(vg);
-    drawContents(vg);
+    if (mTiled)
+    {
+        int origin_x, origin_y, phase;
+        split(mTransform[4], origin_x, phase);
+        split(mTransform[5], origin_y, phase);
+
+        nvgSave(vg);
+        nvgIntersectScissor(vg, mPos.x(), mPos.y(), mSize.x(), mSize.y());
+
+        nanogui::Vector2i first, last;
+        visible_tiles(0, first, last);
+        for (int j = first.y(); j <= last.y(); ++j)
+            for (int i = first.x(); i <= last.x(); ++i)
+            {
+                auto it = mTiles.find(tile_key(i,j));
+                if (it == mTiles.end())
+                    continue;
+
+                float x = origin_x + i*tile_size;
+                float y = origin_y + j*tile_size;
+                nvgBeginPath(vg);
+                nvgRect(vg, x, y, tile_size, tile_size);
+                nvgFillPaint(vg, nvgImagePattern(vg, x, y, tile_size, tile_size, 0, it->second.fb->image, 1));
+                nvgFill(vg);
+            }
 
+        nvgRestore(vg);
+    } else
+        render(vg, mTransform, mPos, mSize);
+
+    nvgSave(vg);
+    nvgTranslate(vg, mPos.x(), mPos.y());
+    drawOverlay(vg);
     nvgRestore(vg);
+
+    if (mActive && mState == State::Select)
+    {
+        nvgBeginPath(vg);
+        nvgRect(vg, std::min(mStart.x(), mLast.x()), std::min(mStart.y(), mLast.y()),
+                    std::abs(mLast.x() - mStart.x()), std::abs(mLast.y() - mStart.y()));
+        nvgFillColor(vg, nanogui::Color { 1.f, 1.f, 1.f, .1f });
+        nvgFill(vg);
+        nvgStrokeColor(vg, nanogui::Color { 1.f, 1.f, 1.f, .8f });
+        nvgStrokeWidth(vg, 1.);
+        nvgStroke(vg);
+    }
+}
+
+void
+profvis::
+Canvas::
+update_cache(NVGcontext* ctx, float pixel_ratio)
+{
+    if (!mVisible)
+        return;
+
+    if (mDirty || pixel_ratio != mTileRatio)
+    {
+        clear_tiles();
+        mDirty     = false;
+        mTileRatio = pixel_ratio;
+    }
+    ++mFrame;
+
+    // tiles in the view must be rendered now; the ring around them is prefetched
+    // within the time budget, so that panning finds them ready
+    std::vector<TileKey> missing;
+    size_t               required = 0;
+    for (int margin = 0; margin < 2; ++margin)
+    {
+        nanogui::Vector2i first, last;
+        visible_tiles(margin, first, last);
+        for (int j = first.y(); j <= last.y(); ++j)
+            for (int i = first.x(); i <= last.x(); ++i)
+            {
+                if (margin == 1 && i > first.x() && i < last.x() && j > first.y() && j < last.y())
+                    continue;       // inner tiles were handled in the first pass
+
+                auto key = tile_key(i,j);
+                auto it  = mTiles.find(key);
+                if (it != mTiles.end())
+                    it->second.used = mFrame;
+                else
+                    missing.push_back(key);
+            }
+
+        if (margin == 0)
+            required = missing.size();
+    }
+
+    if (missing.empty())
+        return;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    int  size  = std::ceil(tile_size * pixel_ratio);
+    auto start = std::chrono::steady_clock::now();
+    size_t rendered = 0;
+    for (auto& key : missing)
+    {
+        if (rendered >= required && std::chrono::steady_clock::now() - start > std::chrono::milliseconds(mTileBudget))
+            break;
+
+        NVGLUframebuffer* fb = nvgluCreateFramebuffer(ctx, size, size, NVG_IMAGE_FLIPY | NVG_IMAGE_NEAREST);
+        if (!fb)            // no framebuffer support, draw() renders directly
+        {
+            clear_tiles();
+            mTiled = false;
+            break;
+        }
+
+        nvgluBindFramebuffer(fb);
+        glViewport(0, 0, size, size);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+        // the tile's own pixels, with the sub-pixel phase of the translation baked in
+        std::array<float,6> xform { key.scale_x, 0, 0, key.scale_y,
+                                    key.phase_x / 64.f - key.i*tile_size,
+                                    key.phase_y / 64.f - key.j*tile_size };
+
+        nvgBeginFrame(ctx, tile_size, tile_size, pixel_ratio);
+        render(ctx, xform, nanogui::Vector2i(0,0), nanogui::Vector2i(tile_size, tile_size));
+        nvgEndFrame(ctx);
+
+        mTiles[key] = Tile { fb, mFrame };
+        mTiled      = true;
+        ++rendered;
+    }
+
+    nvgluBindFramebuffer(nullptr);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    // evict the least recently used tiles
+    while (mTiles.size() > mMaxTiles)
+    {
+        auto oldest = mTiles.begin();
+        for (auto it = mTiles.begin(); it != mTiles.end(); ++it)
+            if (it->second.used < oldest->second.used)
+                oldest = it;
+        if (oldest->second.used == mFrame)
+            break;
+        nvgluDeleteFramebuffer(oldest->second.fb);
+        mTiles.erase(oldest);
+    }
+
+    // keep filling the prefetch ring in the following frames
+    if (mTiled && rendered < missing.size())
+        glfwPostEmptyEvent();
+}
+
+void
+profvis::
+Canvas::
+clear_tiles()
+{
+    for (auto& x : mTiles)
+        nvgluDeleteFramebuffer(x.second.fb);
+    mTiles.clear();
 }
 
 bool
@@ -0,0 +1,249 @@
+#include <profvis/collectives.h>
+#include <profvis/parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+
+using Time        = profvis::Profile::Time;
+using Events      = profvis::Profile::Events;
+using Collectives = profvis::Collectives;
+
+const size_t none = static_cast<size_t>(-1);
+
+// Walks every event, to keep the positions at each depth in step with the EventIndex.
+struct Gather
+{
+            Gather(const std::vector<bool>& collective_):
+                collective(collective_)             {}
+
+    void    traverse(const Events& events, size_t depth)
+    {
+        if (depth >= positions.size())
+            positions.resize(depth + 1, 0);
+
+        for (auto& e : events)
+        {
+            size_t index = positions[depth]++;
+            if (collective[e.id] && open++ == 0)        // a collective nested in another one is part of its call
+            {
+                arrivals.push_back(Collectives::Arrival { calls[e.id]++, e.begin, e.end, 0, depth, index });
+                names.push_back(e.id);
+            }
+            traverse(e.events, depth + 1);
+            if (collective[e.id])
+                --open;
+        }
+    }
+
+    const std::vector<bool>&            collective;
+    int                                 open = 0;       // enclosing collectives
+    std::unordered_map<size_t, size_t>  calls;          // per collective name
+    std::vector<size_t>                 positions;      // per depth
+    std::vector<Collectives::Arrival>   arrivals;       // instance holds the call number, until the instances are known
+    std::vector<size_t>                 names;          // of the arrivals
+};
+
+template<class T>
+void
+atomic_max(std::atomic<T>& x, T value)
+{
+    T current = x.load();
+    while (current < value && !x.compare_exchange_weak(current, value));
+}
+
+template<class T>
+void
+atomic_min(std::atomic<T>& x, T value)
+{
+    T current = x.load();
+    while (value < current && !x.compare_exchange_weak(current, value));
+}
+
+}
+
+bool
+profvis::
+is_collective(const std::string& name)
+{
+    static const char* collectives[] = { "MPI_Barrier", "MPI_Bcast", "MPI_Reduce", "MPI_Allreduce", "MPI_Reduce_scatter",
+                                         "MPI_Reduce_scatter_block", "MPI_Scan", "MPI_Exscan",
+                                         "MPI_Gather", "MPI_Gatherv", "MPI_Allgather", "MPI_Allgatherv",
+                                         "MPI_Scatter", "MPI_Scatterv", "MPI_Alltoall", "MPI_Alltoallv", "MPI_Alltoallw",
+                                         "MPI_Comm_split", "MPI_Comm_dup", "MPI_Comm_create", "MPI_Init", "MPI_Finalize" };
+    for (auto c : collectives)
+        if (name == c)
+            return true;
+    return false;
+}
+
+std::vector<size_t>
+profvis::Collectives::
+offenders(size_t n) const
+{
+    std::vector<size_t> result(caused.size());
+    for (size_t rk = 0; rk < result.size(); ++rk)
+        result[rk] = rk;
+    n = std::min(n, result.size());
+    std::partial_sort(result.begin(), result.begin() + n, result.end(),
+                      [this](size_t a, size_t b) { return caused[a] > caused[b] || (caused[a] == caused[b] && a < b); });
+    result.resize(n);
+    return result;
+}
+
+profvis::Collectives
+profvis::
+analyze_collectives(const Profile& profile)
+{
+    Collectives result;
+    size_t n_ranks = profile.events.size();
+    size_t n_names = profile.names.size();
+
+    std::vector<bool> collective(n_names);
+    for (size_t id = 0; id < n_names; ++id)
+        collective[id] = is_collective(profile.names[id]);
+
+    // the calls of every rank, in time order
+    std::vector<std::vector<size_t>>                        names(n_ranks);
+    std::vector<std::vector<std::pair<size_t, size_t>>>     calls(n_ranks);     // (name, count) of the collectives on each rank
+    result.ranks.resize(n_ranks);
+    parallel_for(n_ranks, [&](size_t rk)
+    {
+        Gather g { collective };
+        g.traverse(profile.events[rk], 0);
+        result.ranks[rk].swap(g.arrivals);
+        names[rk].swap(g.names);
+        calls[rk].insert(calls[rk].end(), g.calls.begin(), g.calls.end());
+    });
+
+    // every name has as many instances as the calls on the rank that makes the most
+    std::vector<size_t> offsets(n_names + 1, 0);
+    for (auto& c : calls)
+        for (auto& x : c)
+            offsets[x.first + 1] = std::max(offsets[x.first + 1], x.second);
+    std::vector<std::vector<std::pair<size_t, size_t>>>().swap(calls);
+    for (size_t id = 0; id < n_names; ++id)
+        offsets[id + 1] += offsets[id];
+    size_t n_instances = offsets.back();
+
+    std::vector<std::atomic<Time>>      first(n_instances), last(n_instances), wait(n_instances);
+    std::vector<std::atomic<size_t>>    late(n_instances), count(n_instances);
+    for (size_t i = 0; i < n_instances; ++i)
+    {
+        first[i] = std::numeric_limits<Time>::max();
+        last[i]  = 0;
+        wait[i]  = 0;
+        late[i]  = none;
+        count[i] = 0;
+    }
+
+    // arrivals
+    parallel_for(n_ranks, [&](size_t rk)
+    {
+        auto& arrivals = result.ranks[rk];
+        for (size_t j = 0; j < arrivals.size(); ++j)
+        {
+            auto& a    = arrivals[j];
+            a.instance = offsets[names[rk][j]] + a.instance;
+            atomic_min(first[a.instance], a.begin);
+            atomic_max(last[a.instance],  a.begin);
+            ++count[a.instance];
+        }
+        std::vector<size_t>().swap(names[rk]);
+    });
+
+    // waits and the last arrivals
+    parallel_for(n_ranks, [&](size_t rk)
+    {
+        for (auto& a : result.ranks[rk])
+        {
+            Time l = last[a.instance];
+            a.wait = std::min(a.end, l) - a.begin;
+            wait[a.instance] += a.wait;
+            if (a.begin == l)
+                atomic_min(late[a.instance], rk);
+        }
+    });
+
+    result.instances.resize(n_instances);
+    for (size_t id = 0; id < n_names; ++id)
+        for (size_t i = offsets[id]; i < offsets[id + 1]; ++i)
+            result.instances[i] = Collectives::Instance { id, i - offsets[id], first[i], last[i], late[i], none, wait[i], count[i] };
+
+    result.waited.assign(n_ranks, 0);
+    result.caused.assign(n_ranks, 0);
+    result.worst.assign(n_ranks, none);
+    parallel_for(n_ranks, [&](size_t rk)
+    {
+        auto& arrivals = result.ranks[rk];
+        for (size_t j = 0; j < arrivals.size(); ++j)
+        {
+            auto& a = arrivals[j];
+            auto& instance = result.instances[a.instance];
+            result.waited[rk] += a.wait;
+            if (instance.late_rank != rk)
+                continue;
+
+            instance.late_index = j;            // only this rank writes it
+            result.caused[rk] += instance.wait;
+            if (result.worst[rk] == none || result.instances[result.worst[rk]].wait < instance.wait)
+                result.worst[rk] = a.instance;
+        }
+    });
+
+    // Critical path, backwards from the last end: the computation that led up to a collective on the
+    // rank that arrived last, and before it, whatever delayed that rank in its previous collective.
+    size_t rk = none;
+    Time   t  = 0;
+    for (size_t r = 0; r < n_ranks; ++r)
+        if (!profile.events[r].empty() && (rk == none || profile.events[r].back().end > t))
+        {
+            rk = r;
+            t  = profile.events[r].back().end;
+        }
+
+    auto& path = result.critical_path;
+    auto  add  = [&path](size_t r, Time b, Time e, bool collective)
+    {
+        if (b < e)
+            path.push_back(Collectives::Segment { r, b, e, collective });
+    };
+    if (rk != none)
+    {
+        size_t j = result.ranks[rk].size();
+        while (true)
+        {
+            auto& arrivals = result.ranks[rk];
+            if (j == 0)
+            {
+                add(rk, std::min(profile.events[rk].front().begin, t), t, false);
+                break;
+            }
+
+            auto& a        = arrivals[--j];
+            auto& instance = result.instances[a.instance];
+            add(rk, std::min(a.end, t), t, false);
+
+            if (instance.last >= a.end || instance.last >= t || instance.late_index == none)
+            {
+                // the call didn't hold this rank back (or the last arrival isn't earlier): stay on it, so that t
+                // decreases with every jump
+                add(rk, a.begin, std::min(a.end, t), true);
+                t = a.begin;
+                continue;
+            }
+
+            add(rk, instance.last, std::min(a.end, t), true);
+            t  = instance.last;
+            rk = instance.late_rank;
+            j  = instance.late_index;
+        }
+        std::reverse(path.begin(), path.end());
+    }
+
+    return result;
+}
@@ -0,0 +1,137 @@
+#include <profvis/concurrency.h>
+#include <profvis/parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+
+using Time   = profvis::Profile::Time;
+using Events = profvis::Profile::Events;
+
+// Buckets [first, last) of the curves: whole buckets go into the difference array, the partly
+// covered ones at the ends of an interval straight into the values.
+struct Slab
+{
+    void    add(size_t id, Time b, Time e, int weight)
+    {
+        double x0 = (double(std::max(b, begin)) - origin) / bucket;
+        double x1 = (double(std::min(e, end))   - origin) / bucket;
+        if (x1 <= x0)
+            return;
+
+        size_t c0 = std::min<size_t>(x0, last - 1);
+        size_t c1 = std::min<size_t>(x1, last - 1);
+        double* v = &partial[id * buckets];
+        if (c0 == c1)
+        {
+            v[c0] += weight * (x1 - x0);
+            return;
+        }
+        v[c0] += weight * (c0 + 1 - x0);
+        v[c1] += weight * (x1 - c1);
+
+        std::int32_t* d = &difference[id * buckets];
+        d[c0 + 1] += weight;
+        d[c1]     -= weight;
+    }
+
+    void    traverse(const Events& events)
+    {
+        auto first = std::partition_point(events.begin(), events.end(),
+                                          [this](const profvis::Profile::Event& e) { return e.end <= begin; });
+        for (auto it = first; it != events.end() && it->begin < end; ++it)
+        {
+            auto& e = *it;
+            if (innermost)
+            {
+                add(e.id, e.begin, e.end, 1);
+                for (auto& c : e.events)
+                    add(e.id, c.begin, c.end, -1);
+            } else if (open[e.id] == 0)
+                add(e.id, e.begin, e.end, 1);
+
+            ++open[e.id];
+            traverse(e.events);
+            --open[e.id];
+        }
+    }
+
+    double                      origin, bucket;
+    size_t                      buckets;
+    size_t                      first, last;
+    Time                        begin, end;             // time of the slab
+    bool                        innermost;
+
+    std::vector<double>&        partial;
+    std::vector<std::int32_t>&  difference;
+    std::vector<int>            open;                   // enclosing events with the same name
+};
+
+}
+
+profvis::Concurrency
+profvis::
+compute_concurrency(const Profile& profile, Profile::Time begin, Profile::Time bucket, size_t buckets, bool innermost)
+{
+    Concurrency result;
+    result.begin    = begin;
+    result.bucket   = std::max<Profile::Time>(bucket, 1);
+    result.buckets  = buckets;
+    result.names    = profile.names.size();
+
+    size_t                      n = result.names * buckets;
+    std::vector<double>         partial(n, 0);
+    std::vector<std::int32_t>   difference(n, 0);
+
+    // slabs write disjoint buckets of the shared arrays
+    size_t slabs = std::min<size_t>(buckets, 4 * std::max(1u, std::thread::hardware_concurrency()));
+    parallel_for(slabs, [&](size_t s)
+    {
+        Slab slab { double(begin), double(result.bucket), buckets,
+                    s * buckets / slabs, (s + 1) * buckets / slabs, 0, 0, innermost,
+                    partial, difference, std::vector<int>(result.names, 0) };
+        slab.begin = begin + slab.first * result.bucket;
+        slab.end   = begin + slab.last  * result.bucket;
+        if (slab.first == slab.last)
+            return;
+
+        for (auto& events : profile.events)
+            slab.traverse(events);
+
+        for (size_t id = 0; id < result.names; ++id)
+        {
+            std::int32_t inside = 0;
+            for (size_t b = slab.first; b < slab.last; ++b)
+            {
+                inside         += difference[id * buckets + b];
+                partial[id * buckets + b] += inside;
+            }
+        }
+    });
+
+    result.values.assign(partial.begin(), partial.end());
+    return result;
+}
+
+profvis::Concurrency
+profvis::
+coarsen(const Concurrency& concurrency, size_t factor)
+{
+    Concurrency result;
+    result.bucket   = concurrency.bucket * factor;
+    result.begin    = concurrency.begin / result.bucket * result.bucket;
+    result.names    = concurrency.names;
+
+    size_t offset   = (concurrency.begin - result.begin) / concurrency.bucket;
+    result.buckets  = (offset + concurrency.buckets + factor - 1) / factor;
+    result.values.assign(result.names * result.buckets, 0);
+
+    for (size_t id = 0; id < result.names; ++id)
+        for (size_t b = 0; b < concurrency.buckets; ++b)
+            result.values[id * result.buckets + (b + offset) / factor] += concurrency(id, b) / factor;
+
+    return result;
+}
@@ -0,0 +1,116 @@
+#include <profvis/context-tree.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+#include <fmt/format.h>
+#include <fmt/ostream.h>
+
+constexpr size_t profvis::ContextTree::root;
+constexpr size_t profvis::ContextTree::none;
+
+namespace
+{
+
+using Tree = profvis::ContextTree;
+
+struct Builder
+{
+    Tree&                                           tree;
+    std::unordered_map<std::uint64_t, size_t>       ids;        // (parent, name) -> node
+
+    size_t      node(size_t parent, size_t name)
+    {
+        std::uint64_t key = (std::uint64_t(parent) << 32) ^ name;
+        auto it = ids.find(key);
+        if (it != ids.end())
+            return it->second;
+
+        size_t id = tree.nodes.size();
+        tree.nodes.push_back(Tree::Node { name, parent, tree.nodes[parent].depth + 1, Tree::Totals { 0, 0, 0 } });
+        tree.nodes[parent].children.push_back(id);
+        ids.emplace(key, id);
+        return id;
+    }
+
+    void        add(const profvis::Profile::Events& events, size_t parent, size_t rk)
+    {
+        for (auto& e : events)
+        {
+            size_t id = node(parent, e.id);
+            add(e.events, id, rk);
+
+            auto& n = tree.nodes[id];
+            if (n.ranks.empty() || n.ranks.back().rank != rk)
+                n.ranks.push_back(Tree::RankTotals { rk, Tree::Totals { 0, 0, 0 } });
+            for (Tree::Totals* t : { &n.totals, &n.ranks.back().totals })
+            {
+                t->inclusive += e.end - e.begin;
+                t->exclusive += e.exclusive;
+                t->count     += 1;
+            }
+        }
+    }
+};
+
+}
+
+size_t
+profvis::ContextTree::
+child(size_t node, size_t name) const
+{
+    for (size_t c : nodes[node].children)
+        if (nodes[c].name == name)
+            return c;
+    return none;
+}
+
+std::string
+profvis::ContextTree::
+path(const Profile& profile, size_t node, char separator) const
+{
+    std::vector<size_t> names;
+    for (; node != root; node = nodes[node].parent)
+        names.push_back(nodes[node].name);
+
+    std::string result;
+    for (auto it = names.rbegin(); it != names.rend(); ++it)
+    {
+        if (!result.empty())
+            result += separator;
+        result += profile.names[*it];
+    }
+    return result;
+}
+
+profvis::ContextTree
+profvis::
+build_context_tree(const Profile& profile)
+{
+    ContextTree tree;
+    tree.nodes.push_back(ContextTree::Node { ContextTree::none, ContextTree::none, 0, ContextTree::Totals { 0, 0, 0 } });
+
+    Builder builder { tree };
+    for (size_t rk = 0; rk < profile.events.size(); ++rk)
+        builder.add(profile.events[rk], ContextTree::root, rk);
+
+    auto& root = tree.nodes[ContextTree::root];
+    for (size_t c : root.children)
+        root.totals.inclusive += tree.nodes[c].totals.inclusive;
+
+    for (auto& n : tree.nodes)
+        std::sort(n.children.begin(), n.children.end(), [&tree](size_t a, size_t b)
+                  { return tree.nodes[a].totals.inclusive > tree.nodes[b].totals.inclusive; });
+
+    return tree;
+}
+
+void
+profvis::
+write_folded(const Profile& profile, const ContextTree& tree, std::ostream& out)
+{
+    for (size_t i = 1; i < tree.nodes.size(); ++i)
+        if (tree.nodes[i].totals.exclusive > 0)
+            fmt::print(out, "{} {}\n", tree.path(profile, i), tree.nodes[i].totals.exclusive);
+}
@@ -0,0 +1,129 @@
+#include <profvis/event-index.h>
+#include <profvis/parallel.h>
+
+#include <algorithm>
+
+namespace
+{
+
+void
+flatten(const profvis::Profile::Events& events, size_t depth, profvis::EventIndex::Depths& depths)
+{
+    if (events.empty())
+        return;
+
+    if (depth >= depths.size())
+        depths.resize(depth + 1);
+
+    for (auto& e : events)
+    {
+        depths[depth].begins.push_back(e.begin);      // not a reference: flattening the children may grow depths
+        depths[depth].events.push_back(&e);
+        flatten(e.events, depth + 1, depths);
+    }
+}
+
+}
+
+constexpr size_t    profvis::EventIndex::block;
+
+size_t
+profvis::EventIndex::Depth::
+next_longer(size_t i, Profile::Time d) const
+{
+    // level 0 is the events, level l > 0 is longest[l - 1]
+    auto size  = [this](size_t l)           { return l == 0 ? events.size() : longest[l - 1].size(); };
+    auto value = [this](size_t l, size_t x) { return l == 0 ? duration(x)   : longest[l - 1][x]; };
+
+    // up: scan the rest of the block, and if it's all shorter, go on with the next block one level up
+    size_t l = 0, x = i;
+    while (true)
+    {
+        size_t end = std::min((x / block + 1) * block, size(l));
+        while (x < end && value(l, x) < d)
+            ++x;
+        if (x < end)
+            break;
+        if (x >= size(l) || l == longest.size())
+            return events.size();
+        x /= block;
+        ++l;
+    }
+
+    // down: the block at x has an event long enough
+    while (l > 0)
+    {
+        --l;
+        x *= block;
+        while (value(l, x) < d)
+            ++x;
+    }
+    return x;
+}
+
+const profvis::Profile::Event*
+profvis::EventIndex::
+find(size_t rk, size_t depth, Profile::Time time) const
+{
+    if (rk >= ranks.size() || depth >= ranks[rk].size())
+        return nullptr;
+
+    auto& d  = ranks[rk][depth];
+    auto  it = std::upper_bound(d.begins.begin(), d.begins.end(), time);
+    if (it == d.begins.begin())
+        return nullptr;
+
+    auto* e = d.events[it - d.begins.begin() - 1];
+    return time <= e->end ? e : nullptr;
+}
+
+profvis::Profile::Time
+profvis::EventIndex::
+covered(size_t rk, size_t depth, Profile::Time begin, Profile::Time end) const
+{
+    if (rk >= ranks.size() || depth >= ranks[rk].size() || end <= begin)
+        return 0;
+
+    auto&   d  = ranks[rk][depth];
+    size_t  lo = std::lower_bound(d.begins.begin(), d.begins.end(), begin) - d.begins.begin();
+    size_t  hi = std::lower_bound(d.begins.begin(), d.begins.end(), end)   - d.begins.begin();
+
+    Profile::Time t = d.sums[hi] - d.sums[lo];
+    if (hi > lo && d.events[hi - 1]->end > end)             // sticks out on the right
+        t -= d.events[hi - 1]->end - end;
+    if (lo > 0 && d.events[lo - 1]->end > begin)            // starts before begin
+        t += std::min(d.events[lo - 1]->end, end) - begin;
+    return t;
+}
+
+profvis::EventIndex
+profvis::
+build_event_index(const Profile& profile)
+{
+    EventIndex index;
+    index.ranks.resize(profile.events.size());
+
+    // a parent comes before its children, and siblings are sorted, so every depth is filled in order of begin
+    parallel_for(profile.events.size(), [&](size_t rk)
+    {
+        flatten(profile.events[rk], 0, index.ranks[rk]);
+
+        for (auto& d : index.ranks[rk])
+        {
+            d.sums.resize(d.events.size() + 1, 0);
+            for (size_t i = 0; i < d.events.size(); ++i)
+                d.sums[i + 1] = d.sums[i] + d.duration(i);
+
+            // maxima over EventIndex::blocks, up to a single EventIndex::block
+            for (size_t n = d.events.size(); n > EventIndex::block; n = d.longest.back().size())
+            {
+                std::vector<Profile::Time> level((n + EventIndex::block - 1) / EventIndex::block, 0);
+                for (size_t x = 0; x < n; ++x)
+                    level[x / EventIndex::block] = std::max(level[x / EventIndex::block], d.longest.empty() ? d.duration(x) : d.longest.back()[x]);
+                d.longest.push_back(std::move(level));
+            }
+        }
+    });
+
+    return index;
+}
@@ -0,0 +1,255 @@
+#include <profvis/export.h>
+
+#include <fstream>
+#include <stdexcept>
+#include <cmath>
+#include <algorithm>
+
+#include <zlib.h>
+
+#include <fmt/format.h>
+#include <fmt/ostream.h>
+
+namespace
+{
+
+const float background[3] = { .3f, .3f, .32f };
+const float margin        = 10;         // above the first and below the last rank
+
+// Maps the content coordinates of the canvas onto the image.
+struct Frame
+{
+    float   x(float cx) const       { return (cx - x0) * sx; }
+    float   y(float cy) const       { return (cy - y0) * sy; }
+    float   w(float cw) const       { return cw * sx; }
+    float   h(float ch) const       { return ch * sy; }
+
+    float   x0, y0, sx, sy;
+    int     width, height;
+};
+
+// Software rasterizer for axis-aligned rectangles, anti-aliased by the area of each pixel they cover.
+class Raster
+{
+    public:
+                Raster(int width, int height):
+                    width_(width), height_(height), pixels_(3 * width * height)
+        {
+            for (size_t i = 0; i < pixels_.size(); i += 3)
+                std::copy(background, background + 3, &pixels_[i]);
+        }
+
+        void    fill(float x, float y, float w, float h, const float color[4])
+        {
+            float x1 = std::min(x + w, float(width_)),  y1 = std::min(y + h, float(height_));
+            x = std::max(x, 0.f);                       y = std::max(y, 0.f);
+            if (x1 <= x || y1 <= y)
+                return;
+
+            for (int j = y; j < y1; ++j)
+            {
+                float cy = std::min(y1, j + 1.f) - std::max(y, float(j));
+                for (int i = x; i < x1; ++i)
+                {
+                    float cx = std::min(x1, i + 1.f) - std::max(x, float(i));
+                    float a  = color[3] * cx * cy;
+                    float* p = &pixels_[3 * (j * width_ + i)];
+                    for (int c = 0; c < 3; ++c)
+                        p[c] = color[c] * a + p[c] * (1 - a);
+                }
+            }
+        }
+
+        void    write_png(std::string fn) const;
+
+    private:
+        int                 width_, height_;
+        std::vector<float>  pixels_;
+};
+
+void
+put32(std::string& s, uint32_t x)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        s.push_back(char((x >> shift) & 0xff));
+}
+
+void
+write_chunk(std::ostream& out, const char* type, const std::string& data)
+{
+    std::string chunk(type, 4);
+    chunk += data;
+
+    std::string header, footer;
+    put32(header, data.size());
+    put32(footer, crc32(0, reinterpret_cast<const Bytef*>(chunk.data()), chunk.size()));
+
+    out << header << chunk << footer;
+}
+
+void
+Raster::
+write_png(std::string fn) const
+{
+    // every row starts with filter type 0 (none)
+    std::string raw;
+    raw.reserve((3 * width_ + 1) * height_);
+    for (int j = 0; j < height_; ++j)
+    {
+        raw.push_back(0);
+        for (int i = 0; i < 3 * width_; ++i)
+            raw.push_back(char(std::lround(std::min(std::max(pixels_[3 * j * width_ + i], 0.f), 1.f) * 255)));
+    }
+
+    uLongf      size = compressBound(raw.size());
+    std::string compressed(size, '\0');
+    if (compress2(reinterpret_cast<Bytef*>(&compressed[0]), &size,
+                  reinterpret_cast<const Bytef*>(raw.data()), raw.size(), 6) != Z_OK)
+        throw std::runtime_error("Failed to compress the image");
+    compressed.resize(size);
+
+    std::ofstream out(fn, std::ios::binary);
+    if (!out)
+        throw std::runtime_error(fmt::format("Cannot write to {}", fn));
+
+    out << "\x89PNG\r\n\x1a\n";
+
+    std::string ihdr;
+    put32(ihdr, width_);
+    put32(ihdr, height_);
+    ihdr += std::string("\x08\x02\x00\x00\x00", 5);     // 8-bit RGB, no interlacing
+    write_chunk(out, "IHDR", ihdr);
+    write_chunk(out, "IDAT", compressed);
+    write_chunk(out, "IEND", "");
+}
+
+void
+export_png(profvis::RectBatches& batches, const profvis::NameColors& colors, const Frame& f,
+           const std::vector<float>& lines, std::string fn)
+{
+    Raster raster(f.width, f.height);
+
+    const float white[4] = { 1, 1, 1, 1 };
+    for (float x : lines)
+        raster.fill(x - .5f, 0, 1, f.height, white);
+
+    batches.for_each([&](size_t id, float alpha, const std::vector<profvis::RectBatches::Rect>& rects)
+    {
+        auto  c        = colors[id];
+        float color[4] = { c.r(), c.g(), c.b(), c.a() * alpha };
+        for (auto& r : rects)
+            raster.fill(f.x(r.x), f.y(r.y), f.w(r.w), f.h(r.h), color);
+    });
+
+    batches.for_each_mixed([&](const float* color, const std::vector<profvis::RectBatches::Rect>& rects)
+    {
+        for (auto& r : rects)
+            raster.fill(f.x(r.x), f.y(r.y), f.w(r.w), f.h(r.h), color);
+    });
+
+    raster.write_png(fn);
+}
+
+std::string
+svg_color(float r, float g, float b, float a)
+{
+    return fmt::format("fill=\"rgb({},{},{})\" fill-opacity=\"{:.3f}\"",
+                       std::lround(r * 255), std::lround(g * 255), std::lround(b * 255), a);
+}
+
+void
+export_svg(profvis::RectBatches& batches, const profvis::NameColors& colors, const Frame& f,
+           const std::vector<float>& lines, std::string fn)
+{
+    std::ofstream out(fn);
+    if (!out)
+        throw std::runtime_error(fmt::format("Cannot write to {}", fn));
+
+    fmt::print(out, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"{0}\" height=\"{1}\" viewBox=\"0 0 {0} {1}\">\n",
+               f.width, f.height);
+    fmt::print(out, "<rect width=\"100%\" height=\"100%\" {}/>\n", svg_color(background[0], background[1], background[2], 1));
+    for (float x : lines)
+        fmt::print(out, "<path d=\"M{:.2f},0v{}\" stroke=\"white\"/>\n", x, f.height);
+
+    // one path per group, like the batches drawn on screen
+    batches.for_each([&](size_t id, float alpha, const std::vector<profvis::RectBatches::Rect>& rects)
+    {
+        auto c = colors[id];
+        fmt::print(out, "<path {} d=\"", svg_color(c.r(), c.g(), c.b(), c.a() * alpha));
+        for (auto& r : rects)
+        {
+            float w = f.w(r.w);
+            fmt::print(out, "M{:.2f},{:.2f}h{:.2f}v{:.2f}h{:.2f}z", f.x(r.x), f.y(r.y), w, f.h(r.h), -w);
+        }
+        fmt::print(out, "\"/>\n");
+    });
+
+    batches.for_each_mixed([&](const float* color, const std::vector<profvis::RectBatches::Rect>& rects)
+    {
+        fmt::print(out, "<path {} d=\"", svg_color(color[0], color[1], color[2], color[3]));
+        for (auto& r : rects)
+        {
+            float w = f.w(r.w);
+            fmt::print(out, "M{:.2f},{:.2f}h{:.2f}v{:.2f}h{:.2f}z", f.x(r.x), f.y(r.y), w, f.h(r.h), -w);
+        }
+        fmt::print(out, "\"/>\n");
+    });
+
+    fmt::print(out, "</svg>\n");
+}
+
+bool
+ends_with(const std::string& s, const std::string& suffix)
+{
+    return s.size() >= suffix.size() && std::equal(suffix.rbegin(), suffix.rend(), s.rbegin());
+}
+
+}
+
+constexpr int   profvis::ExportWindow::max_size;
+
+void
+profvis::
+export_image(ProfileCanvas& canvas, const ExportWindow& window, std::string fn)
+{
+    auto& profile = canvas.profile();
+
+    size_t first = std::min(window.first_rank, profile.events.size());
+    size_t last  = std::min(window.last_rank,  profile.events.size());
+    if (first >= last || window.begin >= window.end || window.width <= 0 || window.height < 0)
+        throw std::runtime_error("Empty export window");
+    if (window.width > ExportWindow::max_size || window.height > ExportWindow::max_size)
+        throw std::runtime_error(fmt::format("Exported images are at most {} pixels on a side", int(ExportWindow::max_size)));
+
+    // the rows at their own height, unless that makes the image too tall
+    float rows = canvas.row_to_y(last - 1) + canvas.base_height() + margin - (canvas.row_to_y(first) - margin);
+    int   height = window.height > 0 ? window.height : std::min<float>(std::ceil(rows), ExportWindow::max_size);
+
+    Frame f;
+    f.x0     = canvas.time_to_x(window.begin);
+    f.y0     = canvas.row_to_y(first) - margin;
+    f.sx     = window.width / (canvas.time_to_x(window.end) - f.x0);
+    f.sy     = height / rows;
+    f.width  = window.width;
+    f.height = height;
+
+    Canvas::View view;
+    view.min   = nanogui::Vector2f(f.x0, f.y0);
+    view.max   = nanogui::Vector2f(canvas.time_to_x(window.end), f.y0 + rows);
+    view.scale = nanogui::Vector2f(f.sx, f.sy);
+
+    // start and end of the profile
+    std::vector<float> lines;
+    for (auto t : { profile.min_time(), profile.max_time() })
+        if (t >= window.begin && t <= window.end)
+            lines.push_back(f.x(canvas.time_to_x(t)));
+
+    auto& batches = canvas.collect(view, first, last);
+
+    if (ends_with(fn, ".svg"))
+        export_svg(batches, canvas.colors(), f, lines, fn);
+    else
+        export_png(batches, canvas.colors(), f, lines, fn);
+
+    batches.clear();
+}
@@ -0,0 +1,415 @@
+#include <profvis/filter.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <memory>
+#include <regex>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+namespace
+{
+
+using Value       = profvis::Filter::Value;
+using Range       = profvis::Filter::Range;
+using Conjunction = profvis::Filter::Conjunction;
+using DNF         = std::vector<Conjunction>;
+
+const Value  max_value       = std::numeric_limits<Value>::max();
+const size_t max_conjunctions = 256;        // past which an expression is rejected, rather than slowing every event down
+
+struct Node
+{
+    enum class Type { And, Or, Not, Names, Duration, Rank, Depth };
+
+    Type                                type;
+    std::vector<std::unique_ptr<Node>>  children;
+    std::vector<bool>                   names;      // Names
+    Range                               range;      // Duration, Rank, Depth
+};
+using NodePtr = std::unique_ptr<Node>;
+
+NodePtr
+make_node(Node::Type type)
+{
+    NodePtr n(new Node);
+    n->type = type;
+    return n;
+}
+
+NodePtr
+make_range(Node::Type type, Value lo, Value hi)
+{
+    auto n = make_node(type);
+    n->range = Range(lo, hi);
+    return n;
+}
+
+NodePtr
+make_binary(Node::Type type, NodePtr a, NodePtr b)
+{
+    auto n = make_node(type);
+    n->children.push_back(std::move(a));
+    n->children.push_back(std::move(b));
+    return n;
+}
+
+NodePtr
+make_not(NodePtr a)
+{
+    auto n = make_node(Node::Type::Not);
+    n->children.push_back(std::move(a));
+    return n;
+}
+
+// Recursive descent over the expression:
+//   or := and ('||' and)*,  and := unary ('&&' unary)*,  unary := '!' unary | '(' or ')' | term
+class Parser
+{
+    public:
+                Parser(const profvis::Profile& profile, const std::string& s):
+                    profile_(profile), s_(s)                {}
+
+        NodePtr parse()
+        {
+            auto n = parse_or();
+            skip();
+            if (pos_ != s_.size())
+                error("unexpected input");
+            return n;
+        }
+
+    private:
+        NodePtr parse_or()
+        {
+            auto n = parse_and();
+            while (accept("||"))
+                n = make_binary(Node::Type::Or, std::move(n), parse_and());
+            return n;
+        }
+
+        NodePtr parse_and()
+        {
+            auto n = parse_unary();
+            while (accept("&&"))
+                n = make_binary(Node::Type::And, std::move(n), parse_unary());
+            return n;
+        }
+
+        NodePtr parse_unary()
+        {
+            if (accept("!"))
+                return make_not(parse_unary());
+            if (accept("("))
+            {
+                auto n = parse_or();
+                expect(")");
+                return n;
+            }
+            return parse_term();
+        }
+
+        NodePtr parse_term()
+        {
+            auto field = identifier();
+            if (field == "name")
+            {
+                bool        regex = false, negate = false;
+                if      (accept("=~"))      regex = true;
+                else if (accept("!~"))      regex = negate = true;
+                else if (accept("=="))      ;
+                else if (accept("!="))      negate = true;
+                else    error("expected =~, !~, ==, or != after name");
+
+                auto pattern = string();
+                auto n       = make_node(Node::Type::Names);
+                n->names.resize(profile_.names.size());
+                if (regex)
+                {
+                    std::regex re;
+                    try
+                    {
+                        re = std::regex(pattern);
+                    } catch (const std::regex_error& e)
+                    {
+                        error(fmt::format("bad regular expression \"{}\"", pattern));
+                    }
+                    for (size_t i = 0; i < profile_.names.size(); ++i)
+                        n->names[i] = std::regex_search(profile_.names[i], re);
+                } else
+                    for (size_t i = 0; i < profile_.names.size(); ++i)
+                        n->names[i] = profile_.names[i] == pattern;
+
+                return negate ? make_not(std::move(n)) : std::move(n);
+            }
+
+            Node::Type type;
+            if      (field == "duration")   type = Node::Type::Duration;
+            else if (field == "rank")       type = Node::Type::Rank;
+            else if (field == "depth")      type = Node::Type::Depth;
+            else    error(fmt::format("unknown field \"{}\"", field));
+
+            bool duration = type == Node::Type::Duration;
+            if (!duration && accept_word("in"))
+            {
+                NodePtr n;
+                do
+                {
+                    Value lo = number(false), hi = lo;
+                    if (accept("-"))
+                        hi = number(false);
+                    auto r = make_range(type, lo, hi);
+                    n = n ? make_binary(Node::Type::Or, std::move(n), std::move(r)) : std::move(r);
+                } while (accept(","));
+                return n;
+            }
+
+            if (accept("<="))       return make_range(type, 0, number(duration));
+            if (accept(">="))       return make_range(type, number(duration), max_value);
+            if (accept("=="))       { auto x = number(duration); return make_range(type, x, x); }
+            if (accept("!="))       { auto x = number(duration); return make_not(make_range(type, x, x)); }
+            if (accept("<"))        { auto x = number(duration); return x == 0 ? make_range(type, 1, 0) : make_range(type, 0, x - 1); }
+            if (accept(">"))        { auto x = number(duration); return x == max_value ? make_range(type, 1, 0) : make_range(type, x + 1, max_value); }
+
+            error(fmt::format("expected a comparison after {}", field));
+            return nullptr;
+        }
+
+        void        skip()                                  { while (pos_ < s_.size() && std::isspace(static_cast<unsigned char>(s_[pos_]))) ++pos_; }
+        bool        accept(const std::string& token)
+        {
+            skip();
+            if (s_.compare(pos_, token.size(), token) != 0)
+                return false;
+            pos_ += token.size();
+            return true;
+        }
+        bool        accept_word(const std::string& word)
+        {
+            skip();
+            size_t end = pos_ + word.size();
+            if (s_.compare(pos_, word.size(), word) != 0 || (end < s_.size() && std::isalnum(static_cast<unsigned char>(s_[end]))))
+                return false;
+            pos_ = end;
+            return true;
+        }
+        void        expect(const std::string& token)        { if (!accept(token)) error(fmt::format("expected {}", token)); }
+
+        std::string identifier()
+        {
+            skip();
+            size_t start = pos_;
+            while (pos_ < s_.size() && (std::isalpha(static_cast<unsigned char>(s_[pos_])) || s_[pos_] == '_'))
+                ++pos_;
+            if (start == pos_)
+                error("expected name, duration, rank, or depth");
+            return s_.substr(start, pos_ - start);
+        }
+
+        std::string string()
+        {
+            skip();
+            if (pos_ >= s_.size() || s_[pos_] != '"')
+                error("expected a quoted string");
+            std::string result;
+            for (++pos_; pos_ < s_.size() && s_[pos_] != '"'; ++pos_)
+            {
+                if (s_[pos_] == '\\' && pos_ + 1 < s_.size() && s_[pos_ + 1] == '"')
+                    ++pos_;
+                result += s_[pos_];
+            }
+            if (pos_ >= s_.size())
+                error("unterminated string");
+            ++pos_;
+            return result;
+        }
+
+        // a whole number; durations may be fractional and carry a unit, and are returned in microseconds
+        Value       number(bool duration)
+        {
+            skip();
+            size_t start = pos_;
+            while (pos_ < s_.size() && (std::isdigit(static_cast<unsigned char>(s_[pos_])) || (duration && s_[pos_] == '.')))
+                ++pos_;
+            if (start == pos_)
+                error("expected a number");
+            double x = std::strtod(s_.substr(start, pos_ - start).c_str(), nullptr);
+
+            if (duration)
+            {
+                if      (accept_word("ns"))     x /= 1000;
+                else if (accept_word("us"))     ;
+                else if (accept_word("ms"))     x *= 1000;
+                else if (accept_word("s"))      x *= 1000000;
+            }
+            if (!(x + .5 < double(max_value)))
+                error("number out of range");
+            return Value(x + .5);
+        }
+
+        [[noreturn]] void   error(const std::string& message) const
+        {
+            throw std::runtime_error(fmt::format("Filter: {} at position {}", message, pos_));
+        }
+
+    private:
+        const profvis::Profile&     profile_;
+        const std::string&          s_;
+        size_t                      pos_ = 0;
+};
+
+Range
+intersect(const Range& a, const Range& b)
+{
+    return Range { std::max(a.lo, b.lo), std::min(a.hi, b.hi) };
+}
+
+bool
+empty(const Conjunction& c)
+{
+    if (c.duration.empty() || c.rank.empty() || c.depth.empty())
+        return true;
+    for (bool x : c.names)
+        if (x)
+            return false;
+    return true;
+}
+
+bool
+contains(const Range& a, const Range& b)
+{
+    return a.lo <= b.lo && b.hi <= a.hi;
+}
+
+// everything b matches, a matches too
+bool
+contains(const Conjunction& a, const Conjunction& b)
+{
+    if (!contains(a.duration, b.duration) || !contains(a.rank, b.rank) || !contains(a.depth, b.depth))
+        return false;
+    for (size_t i = 0; i < a.names.size(); ++i)
+        if (b.names[i] && !a.names[i])
+            return false;
+    return true;
+}
+
+// adds c to the disjunction, unless a conjunction there already covers it, dropping the ones it covers
+void
+add(DNF& dnf, Conjunction c)
+{
+    if (empty(c))
+        return;
+    for (auto& d : dnf)
+        if (contains(d, c))
+            return;
+    dnf.erase(std::remove_if(dnf.begin(), dnf.end(), [&c](const Conjunction& d) { return contains(c, d); }), dnf.end());
+    if (dnf.size() == max_conjunctions)
+        throw std::runtime_error(fmt::format("Filter: the expression expands into more than {} alternatives", max_conjunctions));
+    dnf.push_back(std::move(c));
+}
+
+DNF
+product(const DNF& a, const DNF& b)
+{
+    DNF result;
+    for (auto& x : a)
+        for (auto& y : b)
+        {
+            Conjunction c;
+            c.names.resize(x.names.size());
+            for (size_t i = 0; i < c.names.size(); ++i)
+                c.names[i] = x.names[i] && y.names[i];
+            c.duration = intersect(x.duration, y.duration);
+            c.rank     = intersect(x.rank,     y.rank);
+            c.depth    = intersect(x.depth,    y.depth);
+            add(result, std::move(c));
+        }
+    return result;
+}
+
+Range&
+field(Conjunction& c, Node::Type type)
+{
+    return type == Node::Type::Duration ? c.duration : type == Node::Type::Rank ? c.rank : c.depth;
+}
+
+// disjunctive normal form of the node, or of its negation; negations are pushed down to the terms
+DNF
+dnf(const Node& n, bool negate, size_t names)
+{
+    Conjunction everything;
+    everything.names.assign(names, true);
+
+    switch (n.type)
+    {
+        case Node::Type::Not:
+            return dnf(*n.children[0], !negate, names);
+        case Node::Type::And:
+        case Node::Type::Or:
+        {
+            auto a = dnf(*n.children[0], negate, names);
+            auto b = dnf(*n.children[1], negate, names);
+            if ((n.type == Node::Type::And) != negate)
+                return product(a, b);
+            for (auto& c : b)
+                add(a, std::move(c));
+            return a;
+        }
+        case Node::Type::Names:
+        {
+            for (size_t i = 0; i < names; ++i)
+                everything.names[i] = n.names[i] != negate;
+            return empty(everything) ? DNF() : DNF { everything };
+        }
+        default:            // ranges
+        {
+            DNF result;
+            if (!negate)
+            {
+                field(everything, n.type) = n.range;
+                if (!n.range.empty())
+                    result.push_back(everything);
+            } else if (n.range.empty())
+                result.push_back(everything);
+            else
+            {
+                if (n.range.lo > 0)
+                {
+                    result.push_back(everything);
+                    field(result.back(), n.type) = Range { 0, n.range.lo - 1 };
+                }
+                if (n.range.hi < max_value)
+                {
+                    result.push_back(everything);
+                    field(result.back(), n.type) = Range { n.range.hi + 1, max_value };
+                }
+            }
+            return result;
+        }
+    }
+}
+
+}
+
+profvis::Filter
+profvis::
+compile_filter(const Profile& profile, const std::string& expression)
+{
+    Filter filter;
+    if (expression.find_first_not_of(" \t") == std::string::npos)
+        return filter;
+
+    auto root = Parser(profile, expression).parse();
+
+    filter.all          = false;
+    filter.conjunctions = dnf(*root, false, profile.names.size());
+    filter.any_name.assign(profile.names.size(), false);
+    for (auto& c : filter.conjunctions)
+        for (size_t i = 0; i < c.names.size(); ++i)
+            if (c.names[i])
+                filter.any_name[i] = true;
+
+    return filter;
+}
@@ -0,0 +1,119 @@
+#include <profvis/heatmap.h>
+#include <profvis/parallel.h>
+
+#include <algorithm>
+
+namespace
+{
+
+using Time   = profvis::Profile::Time;
+using Events = profvis::Profile::Events;
+
+// Time of a single row, spread over the columns.
+struct Row
+{
+    using Cell = std::vector<std::pair<std::uint32_t, float>>;     // fraction of the column covered, per name
+
+    void    add(Time b, Time e, size_t id)
+    {
+        double x0 = (double(std::max(b, begin)) - begin) / width;
+        double x1 = (double(std::min(e, end))   - begin) / width;
+        if (x1 <= x0)
+            return;
+
+        size_t c0 = x0;
+        size_t c1 = std::min<size_t>(x1, cells.size() - 1);
+        for (size_t c = c0; c <= c1; ++c)
+        {
+            float covered = std::min(x1, c + 1.) - std::max(x0, double(c));
+            if (covered <= 0)
+                continue;
+
+            auto& cell = cells[c];
+            auto  it   = std::find_if(cell.begin(), cell.end(),
+                                      [id](const std::pair<std::uint32_t, float>& x) { return x.first == id; });
+            if (it != cell.end())
+                it->second += covered;
+            else
+                cell.emplace_back(id, covered);
+        }
+    }
+
+    // events at the given depth, or with the given name at any depth
+    void    traverse(const Events& events, size_t level, size_t depth, size_t name)
+    {
+        auto first = std::partition_point(events.begin(), events.end(),
+                                          [this](const profvis::Profile::Event& e) { return e.end < begin; });
+        for (auto it = first; it != events.end() && it->begin < end; ++it)
+        {
+            auto& e = *it;
+            if (name == profvis::Heatmap::dominant)
+            {
+                if (level == depth)
+                    add(e.begin, e.end, e.id);
+                else
+                    traverse(e.events, level + 1, depth, name);
+            } else if (e.id == name)
+                add(e.begin, e.end, e.id);      // don't count the name nested in itself twice
+            else
+                traverse(e.events, level + 1, depth, name);
+        }
+    }
+
+    Time                begin, end;
+    double              width;
+    std::vector<Cell>   cells;
+};
+
+}
+
+constexpr size_t    profvis::Heatmap::dominant;
+
+profvis::Heatmap
+profvis::
+compute_heatmap(const Profile& profile, Profile::Time begin, Profile::Time end,
+                size_t columns, size_t rows, size_t depth, size_t name, const std::vector<size_t>& order)
+{
+    Heatmap heatmap;
+
+    size_t ranks = profile.events.size();
+    if (ranks == 0 || columns == 0 || rows == 0 || end <= begin)
+        return heatmap;
+
+    rows = std::min(rows, ranks);
+    heatmap.columns = columns;
+    heatmap.rows    = rows;
+    heatmap.ids.resize(columns * rows, static_cast<std::uint32_t>(-1));
+    heatmap.values.resize(columns * rows, 0);
+
+    parallel_for(rows, [&](size_t r)
+    {
+        size_t first = r * ranks / rows;
+        size_t last  = (r + 1) * ranks / rows;
+
+        Row row { begin, end, double(end - begin) / columns, std::vector<Row::Cell>(columns) };
+        for (size_t i = first; i < last; ++i)
+            row.traverse(profile.events[order.empty() ? i : order[i]], 0, depth, name);
+
+        for (size_t c = 0; c < columns; ++c)
+        {
+            auto& cell = row.cells[c];
+            if (cell.empty())
+                continue;
+
+            float total = 0;
+            auto  best  = cell.begin();
+            for (auto it = cell.begin(); it != cell.end(); ++it)
+            {
+                total += it->second;
+                if (it->second > best->second)
+                    best = it;
+            }
+
+            heatmap.ids[r*columns + c]    = best->first;
+            heatmap.values[r*columns + c] = std::min(1.f, total / (last - first));
+        }
+    });
+
+    return heatmap;
+}
@@ -0,0 +1,228 @@
+#include <profvis/lod.h>
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+
+using Time  = profvis::Profile::Time;
+using LOD   = profvis::LevelOfDetail;
+
+// Fills level 0 of a single depth; events arrive sorted by begin and don't overlap.
+struct Accumulator
+{
+    void    add_event(Time begin, Time end, size_t id)
+    {
+        begin = std::max(begin, min_time);
+        if (end <= begin)
+            return;
+
+        size_t first = (begin - min_time) / width;
+        size_t last  = std::min((end - 1 - min_time) / width, buckets->size() - 1);
+
+        if (first == last)
+        {
+            add(first, id, end - begin);
+            return;
+        }
+
+        add(first, id, min_time + (first + 1)*width - begin);
+        for (size_t b = first + 1; b < last; ++b)
+            (*buckets)[b] = LOD::Bucket { static_cast<std::uint32_t>(id), 1.f };
+        add(last, id, end - min_time - last*width);
+    }
+
+    void    add(size_t b, size_t id, Time t)
+    {
+        if (b != current)
+        {
+            flush();
+            current = b;
+        }
+
+        for (auto& x : names)
+            if (x.first == id)
+            {
+                x.second += t;
+                return;
+            }
+        names.emplace_back(id, t);
+    }
+
+    void    flush()
+    {
+        if (names.empty())
+            return;
+
+        Time total = 0;
+        auto dominant = names.begin();
+        for (auto it = names.begin(); it != names.end(); ++it)
+        {
+            total += it->second;
+            if (it->second > dominant->second)
+                dominant = it;
+        }
+
+        auto& bucket = (*buckets)[current];
+        bucket.id   = dominant->first;
+        bucket.busy = std::min(1.f, float(total) / width);
+
+        names.clear();
+    }
+
+    LOD::Buckets*                           buckets;
+    Time                                    min_time;
+    Time                                    width;
+
+    size_t                                  current = static_cast<size_t>(-1);
+    std::vector<std::pair<size_t, Time>>    names;          // time per name in the current bucket
+};
+
+void
+count_events(const profvis::Profile::Events& events, size_t depth, std::vector<size_t>& counts)
+{
+    if (events.empty())
+        return;
+
+    if (depth >= counts.size())
+        counts.resize(depth + 1, 0);
+    counts[depth] += events.size();
+
+    for (auto& e : events)
+        count_events(e.events, depth + 1, counts);
+}
+
+void
+fill(const profvis::Profile::Events& events, size_t depth, std::vector<Accumulator>& accumulators)
+{
+    for (auto& e : events)
+    {
+        accumulators[depth].add_event(e.begin, e.end, e.id);
+        fill(e.events, depth + 1, accumulators);
+    }
+}
+
+LOD::Buckets
+coarsen(const LOD::Buckets& fine)
+{
+    LOD::Buckets coarse((fine.size() + LOD::fanout - 1) / LOD::fanout);
+
+    for (size_t i = 0; i < coarse.size(); ++i)
+    {
+        // weigh the dominant names of the children by how busy they are
+        std::array<std::pair<std::uint32_t, float>, LOD::fanout>  weights;
+        size_t  n    = 0;
+        float   busy = 0;
+        for (size_t j = i*LOD::fanout; j < std::min((i + 1)*LOD::fanout, fine.size()); ++j)
+        {
+            auto& b = fine[j];
+            if (b.id == LOD::Bucket::empty)
+                continue;
+
+            busy += b.busy;
+
+            size_t k = 0;
+            while (k < n && weights[k].first != b.id) ++k;
+            if (k == n)
+                weights[n++] = { b.id, 0.f };
+            weights[k].second += b.busy;
+        }
+
+        if (n == 0)
+            continue;
+
+        auto dominant = std::max_element(weights.begin(), weights.begin() + n,
+                                         [](const std::pair<std::uint32_t, float>& x, const std::pair<std::uint32_t, float>& y)
+                                         { return x.second < y.second; });
+        coarse[i].id   = dominant->first;
+        coarse[i].busy = busy / LOD::fanout;
+    }
+
+    return coarse;
+}
+
+}
+
+constexpr std::uint32_t     profvis::LevelOfDetail::Bucket::empty;
+constexpr size_t            profvis::LevelOfDetail::fanout;
+
+int
+profvis::LevelOfDetail::
+level(size_t rk, double time_per_pixel) const
+{
+    auto& rank = ranks[rk];
+    if (rank.depths.empty() || time_per_pixel < rank.width)
+        return -1;
+
+    int     levels = rank.depths[0].size();
+    int     l      = 0;
+    double  w      = rank.width;
+    while (l + 1 < levels && w * fanout <= time_per_pixel)
+    {
+        w *= fanout;
+        ++l;
+    }
+    return l;
+}
+
+profvis::Profile::Time
+profvis::LevelOfDetail::
+width(size_t rk, int level) const
+{
+    Time w = ranks[rk].width;
+    for (int l = 0; l < level; ++l)
+        w *= fanout;
+    return w;
+}
+
+profvis::LevelOfDetail
+profvis::
+build_lod(const Profile& profile)
+{
+    LevelOfDetail lod;
+    lod.min_time = profile.min_time();
+    lod.ranks.resize(profile.events.size());
+
+    Time range = profile.max_time() > profile.min_time() ? profile.max_time() - profile.min_time() : 1;
+
+    for (size_t rk = 0; rk < profile.events.size(); ++rk)
+    {
+        std::vector<size_t> counts;
+        count_events(profile.events[rk], 0, counts);
+        if (counts.empty())
+            continue;
+
+        // level 0 has roughly as many buckets as the most populated depth has events
+        size_t max_count = *std::max_element(counts.begin(), counts.end());
+        auto& rank  = lod.ranks[rk];
+        rank.width  = std::max<Time>(1, (range + max_count - 1) / max_count);
+        size_t size = range / rank.width + 1;
+
+        rank.depths.resize(counts.size());
+        std::vector<Accumulator> accumulators(counts.size());
+        for (size_t d = 0; d < counts.size(); ++d)
+        {
+            rank.depths[d].emplace_back(size);
+            accumulators[d].buckets  = &rank.depths[d][0];
+            accumulators[d].min_time = lod.min_time;
+            accumulators[d].width    = rank.width;
+        }
+
+        fill(profile.events[rk], 0, accumulators);
+
+        for (size_t d = 0; d < counts.size(); ++d)
+        {
+            accumulators[d].flush();
+
+            auto& levels = rank.depths[d];
+            while (levels.back().size() > 1)
+            {
+                auto coarse = coarsen(levels.back());
+                levels.emplace_back(std::move(coarse));
+            }
+        }
+    }
+
+    return lod;
+}
@@ -0,0 +1,166 @@
+#include <profvis/messages.h>
+#include <profvis/parallel.h>
+
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+
+namespace
+{
+
+using Time     = profvis::Profile::Time;
+using Endpoint = profvis::Profile::Endpoint;
+using Flow     = profvis::Messages::Flow;
+using Level    = profvis::Messages::Level;
+
+struct Channel
+{
+    std::uint32_t   src, dst;
+    std::int32_t    tag;
+
+    bool            operator==(const Channel& other) const      { return src == other.src && dst == other.dst && tag == other.tag; }
+};
+
+struct ChannelHash
+{
+    size_t          operator()(const Channel& c) const
+    {
+        std::uint64_t h = (std::uint64_t(c.src) << 32) | c.dst;
+        return std::hash<std::uint64_t>()(h * 0x9E3779B97F4A7C15ull ^ std::uint32_t(c.tag));
+    }
+};
+
+Channel
+channel(const Endpoint& e)
+{
+    return e.send ? Channel { e.rank, e.peer, e.tag } : Channel { e.peer, e.rank, e.tag };
+}
+
+void
+finish(Level& level)
+{
+    std::sort(level.flows.begin(), level.flows.end(), [](const Flow& a, const Flow& b) { return a.send < b.send; });
+    level.reach.resize(level.flows.size());
+    Time reach = 0;
+    for (size_t i = 0; i < level.flows.size(); ++i)
+    {
+        reach = std::max(reach, std::max(level.flows[i].send, level.flows[i].recv));
+        level.reach[i] = reach;
+    }
+}
+
+// bundles the flows between the same ranks whose sends fall into the same bucket
+Level
+coarsen(const Level& fine, Time bucket)
+{
+    struct Bundle
+    {
+        double          send = 0, recv = 0;
+        std::uint32_t   count = 0;
+    };
+
+    Level coarse;
+    coarse.bucket = bucket;
+
+    std::unordered_map<std::uint64_t, Bundle> bundles;
+    auto flush = [&]()
+    {
+        for (auto& x : bundles)
+            coarse.flows.push_back(Flow { std::uint32_t(x.first >> 32), std::uint32_t(x.first),
+                                          Time(x.second.send / x.second.count), Time(x.second.recv / x.second.count),
+                                          x.second.count });
+        bundles.clear();
+    };
+
+    // the flows are sorted by send, so a bucket's flows are consecutive
+    Time current = 0;
+    for (auto& f : fine.flows)
+    {
+        if (f.send / bucket != current)
+        {
+            flush();
+            current = f.send / bucket;
+        }
+        auto& b  = bundles[(std::uint64_t(f.src) << 32) | f.dst];
+        b.send  += double(f.send) * f.count;
+        b.recv  += double(f.recv) * f.count;
+        b.count += f.count;
+    }
+    flush();
+
+    finish(coarse);
+    return coarse;
+}
+
+}
+
+profvis::Messages
+profvis::
+match_messages(const Profile& profile)
+{
+    Messages messages;
+    messages.levels.emplace_back();
+    auto& base = messages.levels[0];
+    base.bucket = 0;
+
+    auto& endpoints = profile.endpoints;
+    if (endpoints.empty())
+        return messages;
+
+    // each shard owns the channels that hash to it; the endpoints are dealt out to the shards in one pass
+    size_t shards = 4 * std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::vector<std::uint32_t>> owned(shards);
+    ChannelHash hash;
+    for (size_t i = 0; i < endpoints.size(); ++i)
+        owned[hash(channel(endpoints[i])) % shards].push_back(i);
+
+    std::vector<std::vector<Flow>>  flows(shards);
+    std::atomic<size_t>             unmatched(0);
+    parallel_for(shards, [&](size_t s)
+    {
+        std::unordered_map<Channel, std::pair<std::vector<std::uint32_t>, std::vector<std::uint32_t>>, ChannelHash> channels;
+        for (std::uint32_t i : owned[s])
+        {
+            auto& sides = channels[channel(endpoints[i])];
+            (endpoints[i].send ? sides.first : sides.second).push_back(i);
+        }
+        std::vector<std::uint32_t>().swap(owned[s]);
+
+        auto by_begin = [&endpoints](std::uint32_t a, std::uint32_t b) { return endpoints[a].begin < endpoints[b].begin; };
+        for (auto& x : channels)
+        {
+            auto& sends = x.second.first;
+            auto& recvs = x.second.second;
+            std::sort(sends.begin(), sends.end(), by_begin);
+            std::sort(recvs.begin(), recvs.end(), by_begin);
+
+            size_t n = std::min(sends.size(), recvs.size());
+            for (size_t k = 0; k < n; ++k)
+                flows[s].push_back(Flow { x.first.src, x.first.dst, endpoints[sends[k]].begin, endpoints[recvs[k]].end, 1 });
+            unmatched += sends.size() + recvs.size() - 2*n;
+        }
+    });
+
+    for (auto& f : flows)
+    {
+        base.flows.insert(base.flows.end(), f.begin(), f.end());
+        std::vector<Flow>().swap(f);
+    }
+    finish(base);
+    messages.unmatched = unmatched;
+
+    // coarser levels, eight times longer buckets each, until bundling stops paying off
+    const size_t    few    = 4096;
+    Time            span   = profile.max_time() - profile.min_time();
+    Time            bucket = 8;
+    while (messages.levels.back().flows.size() > few && bucket < span)
+    {
+        auto level = coarsen(messages.levels.back(), bucket);
+        bucket *= 8;
+        if (level.flows.size() > .9 * messages.levels.back().flows.size())
+            continue;           // too few messages share a bucket yet
+        messages.levels.push_back(std::move(level));
+    }
+
+    return messages;
+}
@@ -0,0 +1,136 @@
+#include <profvis/name-list.h>
+
+#include <algorithm>
+#include <cctype>
+
+#include <fmt/format.h>
+
+constexpr size_t    profvis::NameList::none;
+
+profvis::NameList::
+NameList(nanogui::Widget* parent, ProfileCanvas* canvas, const std::vector<Profile::Time>& totals):
+    nanogui::Widget(parent),
+    canvas_(canvas),
+    totals_(totals),
+    order_(totals.size()),
+    callback_([](size_t) {})
+{
+    for (size_t i = 0; i < order_.size(); ++i)
+        order_[i] = i;
+    std::sort(order_.begin(), order_.end(), [this](size_t a, size_t b) { return totals_[a] > totals_[b]; });
+    shown_ = order_;
+}
+
+void
+profvis::NameList::
+set_search(const std::string& s)
+{
+    auto lower = [](unsigned char c) { return std::tolower(c); };
+    auto equal = [&lower](char a, char b) { return lower(a) == lower(b); };
+
+    auto& names = canvas_->profile().names;
+    shown_.clear();
+    for (size_t id : order_)
+        if (std::search(names[id].begin(), names[id].end(), s.begin(), s.end(), equal) != names[id].end())
+            shown_.push_back(id);
+
+    scroll_ = std::min(scroll_, max_scroll());
+}
+
+void
+profvis::NameList::
+draw(NVGcontext* ctx)
+{
+    NVGcontext* vg = ctx;
+
+    nvgSave(vg);
+    nvgIntersectScissor(vg, mPos.x(), mPos.y(), mSize.x(), mSize.y());
+
+    nvgBeginPath(vg);
+    nvgRect(vg, mPos.x(), mPos.y(), mSize.x(), mSize.y());
+    nvgFillColor(vg, nanogui::Color { 0.f, 0.f, 0.f, .3f });
+    nvgFill(vg);
+
+    nvgFontSize(vg, 16);
+    nvgFontFace(vg, "sans");
+
+    const float swatch = row_height - 6, padding = 4, total_width = 70;
+    bool        scrolls = max_scroll() > 0;
+    float       right   = mPos.x() + mSize.x() - (scrolls ? 8 : 0);
+
+    auto&   profile = canvas_->profile();
+    size_t  first   = scroll_ / row_height;
+    size_t  last    = std::min<size_t>(shown_.size(), (scroll_ + mSize.y()) / row_height + 1);
+    for (size_t i = first; i < last; ++i)
+    {
+        size_t  id     = shown_[i];
+        bool    hidden = canvas_->hidden(id);
+        float   y      = mPos.y() + i*row_height - scroll_;
+
+        if (id == selected_)
+        {
+            nvgBeginPath(vg);
+            nvgRect(vg, mPos.x(), y, right - mPos.x(), row_height);
+            nvgFillColor(vg, nanogui::Color { 1.f, 1.f, 1.f, .15f });
+            nvgFill(vg);
+        }
+
+        auto c = canvas_->colors()[id];
+        if (hidden)
+            c.a() = .2f;
+        nvgBeginPath(vg);
+        nvgRect(vg, mPos.x() + padding, y + 3, swatch, swatch);
+        nvgFillColor(vg, c);
+        nvgFill(vg);
+
+        nanogui::Color text { 1.f, 1.f, 1.f, hidden ? .4f : .9f };
+        nvgFillColor(vg, text);
+
+        nvgTextAlign(vg, NVG_ALIGN_RIGHT | NVG_ALIGN_MIDDLE);
+        auto total = fmt::format("{:.3f} s", totals_[id] / 1e6);
+        nvgText(vg, right - padding, y + row_height/2, total.c_str(), nullptr);
+
+        nvgSave(vg);
+        float x = mPos.x() + 2*padding + swatch;
+        nvgIntersectScissor(vg, x, y, right - total_width - x, row_height);
+        nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
+        nvgText(vg, x, y + row_height/2, profile.names[id].c_str(), nullptr);
+        nvgRestore(vg);
+    }
+
+    if (scrolls)
+    {
+        float height = shown_.size() * row_height;
+        nvgBeginPath(vg);
+        nvgRoundedRect(vg, right + 2, mPos.y() + scroll_ / height * mSize.y(),
+                       4, std::max(mSize.y() * mSize.y() / height, 8.f), 2);
+        nvgFillColor(vg, nanogui::Color { 1.f, 1.f, 1.f, .4f });
+        nvgFill(vg);
+    }
+
+    nvgRestore(vg);
+}
+
+bool
+profvis::NameList::
+mouseButtonEvent(const nanogui::Vector2i &p, int button, bool down, int modifiers)
+{
+    if (button != GLFW_MOUSE_BUTTON_1 || !down)
+        return true;
+
+    size_t i = (p.y() - mPos.y() + scroll_) / row_height;
+    if (i < shown_.size())
+    {
+        selected_ = shown_[i];
+        callback_(selected_);
+    }
+    return true;
+}
+
+bool
+profvis::NameList::
+scrollEvent(const nanogui::Vector2i &p, const nanogui::Vector2f &rel)
+{
+    scroll_ = std::min(std::max(scroll_ - 3*row_height*rel.y(), 0.f), max_scroll());
+    return true;
+}
@@ -0,0 +1,58 @@
+#include <profvis/occurrences.h>
+#include <profvis/parallel.h>
+
+#include <algorithm>
+
+size_t
+profvis::Occurrences::
+first_after(size_t name, Profile::Time time) const
+{
+    return std::lower_bound(by_begin.begin() + first(name), by_begin.begin() + last(name), time,
+                            [](const Occurrence& o, Profile::Time t) { return o.begin < t; })
+           - by_begin.begin();
+}
+
+profvis::Occurrences
+profvis::
+build_occurrences(const Profile& profile, const EventIndex& index)
+{
+    Occurrences occurrences;
+
+    // counting sort by name
+    occurrences.offsets.assign(profile.names.size() + 1, 0);
+    for (auto& rank : index.ranks)
+        for (auto& depth : rank)
+            for (auto* e : depth.events)
+                ++occurrences.offsets[e->id + 1];
+    for (size_t i = 0; i < profile.names.size(); ++i)
+        occurrences.offsets[i + 1] += occurrences.offsets[i];
+
+    auto next = occurrences.offsets;
+    occurrences.by_begin.resize(occurrences.offsets.back());
+    for (size_t rk = 0; rk < index.ranks.size(); ++rk)
+        for (size_t d = 0; d < index.ranks[rk].size(); ++d)
+        {
+            auto& events = index.ranks[rk][d].events;
+            for (size_t i = 0; i < events.size(); ++i)
+                occurrences.by_begin[next[events[i]->id]++] =
+                    Occurrences::Occurrence { events[i]->begin, events[i]->end - events[i]->begin,
+                                              std::uint32_t(rk), std::uint32_t(d), std::uint32_t(i) };
+        }
+
+    occurrences.by_duration.resize(occurrences.by_begin.size());
+    parallel_for(profile.names.size(), [&](size_t name)
+    {
+        auto first = occurrences.by_begin.begin() + occurrences.first(name);
+        auto last  = occurrences.by_begin.begin() + occurrences.last(name);
+        std::sort(first, last, [](const Occurrences::Occurrence& a, const Occurrences::Occurrence& b)
+                               { return a.begin < b.begin || (a.begin == b.begin && a.rank < b.rank); });
+
+        auto& order = occurrences.by_duration;
+        for (size_t i = occurrences.first(name); i < occurrences.last(name); ++i)
+            order[i] = i;
+        std::sort(order.begin() + occurrences.first(name), order.begin() + occurrences.last(name),
+                  [&occurrences](size_t a, size_t b) { return occurrences.by_begin[a].duration > occurrences.by_begin[b].duration; });
+    });
+
+    return occurrences;
+}
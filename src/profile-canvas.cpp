@@ -1,11 +1,58 @@
 #include <profvis/profile-canvas.h>
 
+#include <algorithm>
+#include <cmath>
+
+#include <fmt/format.h>
+
+namespace
+{
+
+// adjacent sub-pixel siblings, merged into a single rectangle
+struct MergedRun
+{
+    void    add(const profvis::Profile::Event& e, const nanogui::Color& c)
+    {
+        if (count++ == 0)
+            begin = e.begin;
+        end = e.end;
+
+        float duration = e.end - e.begin;
+        covered += duration;
+        r += c.r() * duration;
+        g += c.g() * duration;
+        b += c.b() * duration;
+    }
+
+    size_t                  count   = 0;
+    profvis::Profile::Time  begin   = 0;
+    profvis::Profile::Time  end     = 0;
+    float                   covered = 0;
+    float                   r = 0, g = 0, b = 0;
+};
+
+}
+
+void
+profvis::ProfileCanvas::
+draw(NVGcontext* ctx)
+{
+    Canvas::draw(ctx);
+
+    stats_.time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start_).count();
+    frame_times_.add(stats_.time);
+    last_stats_ = stats_;
+}
+
 void
 profvis::ProfileCanvas::
 drawContents(NVGcontext* ctx)
 {
     NVGcontext* vg = ctx;
 
+    if (heatmap)            // drawn by drawOverlay() instead
+        return;
+
     // start-time
     nvgBeginPath(vg);
     nvgMoveTo(vg, init_hoffset, init_voffset);
@@ -22,48 +69,780 @@ drawContents(NVGcontext* ctx)
     nvgStrokeWidth(vg, 1.);
     nvgStroke(vg);
 
-    for (size_t rk = 0; rk < profile_.events.size(); ++rk)
-        draw_events(ctx, profile_.events[rk], init_hoffset, init_voffset + (base_height() + rank_gap)*rk, base_height());
+    collect(mView, 0, profile_.events.size());
+    draw_batches(ctx);
+}
+
+profvis::RectBatches&
+profvis::ProfileCanvas::
+collect(const View& view, size_t first_row, size_t last_row)
+{
+    mView = view;
+    batches_.clear();
+
+    // visible time interval
+    double range = profile_.max_time() - profile_.min_time();
+    double begin = profile_.min_time() + (mView.min.x() - init_hoffset) / width * range;
+    double end   = profile_.min_time() + (mView.max.x() - init_hoffset) / width * range;
+    view_begin_  = std::max(0., begin);
+    view_end_    = std::max(0., end);
+
+    // once several buckets of the pyramid fit into a pixel, draw them instead of the events
+    double time_per_pixel = range / (width * mView.scale.x());
+    pixel_time_ = time_per_pixel;
+
+    // visible ranks
+    double  pitch   = base_height() + rank_gap;
+    long    top     = std::floor((mView.min.y() - init_voffset) / pitch);
+    long    bottom  = std::floor((mView.max.y() - init_voffset) / pitch);
+
+    size_t  first   = std::max<long>(top - long(rank_margin), first_row);
+    size_t  last    = std::min<long>(std::max(bottom + long(rank_margin) + 1, 0l), last_row);
+
+    // top-level events of the rows outside the view, without looking at them
+    auto events_in = [this](size_t b, size_t e) { return b < e ? row_events_[e] - row_events_[b] : 0; };
+    stats_.culled_view += first < last ? events_in(first_row, first) + events_in(last, last_row) : events_in(first_row, last_row);
+
+    for (size_t row = first; row < last; ++row)
+    {
+        size_t rk      = order_[row];
+        size_t voffset = row_to_y(row);
+        int    level   = level_of_detail ? lod_.level(rk, time_per_pixel) : -1;
+        if (level >= 0)
+            draw_lod(rk, level, init_hoffset, voffset, base_height());
+        else
+            draw_events(profile_.events[rk], rk, 0, init_hoffset, voffset, base_height());
+    }
+
+    // draw_batches() fills every group, and every colour of the merged rectangles, with one path
+    stats_.draw_calls += batches_.groups();
+
+    return batches_;
+}
+
+void
+profvis::ProfileCanvas::
+drawOverlay(NVGcontext* ctx)
+{
+    if (heatmap)
+        draw_heatmap(ctx);
+    else
+        draw_ranks(ctx);
+
+    if (labels && !heatmap)
+        draw_labels(ctx);
+
+    if (messages && !heatmap)
+        draw_messages(ctx);
+
+    if (!path_.empty() && !heatmap)
+        draw_path(ctx);
+
+    if (focused_ && !heatmap)
+        draw_focus(ctx);
+
+    if (concurrency && !heatmap)
+        draw_concurrency(ctx);
+
+    if (statistics)
+        draw_statistics(ctx);
 }
 
 void
 profvis::ProfileCanvas::
-draw_events(NVGcontext* ctx, const Profile::Events& events, size_t hoffset, size_t voffset, size_t height)
+draw_ranks(NVGcontext* ctx)
 {
-    for (auto& e : events)
+    NVGcontext* vg = ctx;
+
+    // ranks outside the whole view (drawContents() may be rendering just a tile of it)
+    View    v       = view(mTransform, mPos, mSize);
+    double  pitch   = base_height() + rank_gap;
+    long    n_ranks = profile_.events.size();
+    long    top     = std::floor((v.min.y() - init_voffset) / pitch);
+    long    bottom  = std::floor((v.max.y() - init_voffset) / pitch);
+    size_t  ranks_above = std::min(std::max(top, 0l), n_ranks);
+    size_t  ranks_below = std::min(std::max(n_ranks - 1 - bottom, 0l), n_ranks);
+
+    auto indicator = [this,vg](size_t count, std::string where, float y, int align)
     {
-        if (e.end - e.begin < time_filter) continue;
+        if (count == 0)
+            return;
 
-        NVGcontext* vg = ctx;
+        std::string text = std::to_string(count) + (count == 1 ? " rank " : " ranks ") + where;
+
+        nvgFontSize(vg, 16);
+        nvgFontFace(vg, "sans");
+        nvgTextAlign(vg, NVG_ALIGN_CENTER | align);
+        nvgFillColor(vg, ng::Color { 1.f, 1.f, 1.f, .8f });
+        nvgText(vg, mSize.x() / 2, y, text.c_str(), nullptr);
+    };
+
+    indicator(ranks_above, "above", 5 + (concurrency ? concurrency_height : 0),    NVG_ALIGN_TOP);
+    indicator(ranks_below, "below", mSize.y() - 5 - (overview ? overview_height : 0),  NVG_ALIGN_BOTTOM);
+
+    if (overview)
+        draw_overview(ctx);
+}
+
+void
+profvis::ProfileCanvas::
+draw_statistics(NVGcontext* ctx)
+{
+    NVGcontext* vg = ctx;
+
+    const float w = 230, line = 16, padding = 8, plot = 50;
+    const size_t bins = 30;
+
+    std::vector<std::string> lines
+    {
+        fmt::format("frame        {:.2f} ms", last_stats_.time),
+        fmt::format("visited      {}", last_stats_.visited),
+        fmt::format("rects        {}", last_stats_.rects),
+        fmt::format("culled: filter {}, hidden {}, view {}",
+                    last_stats_.culled_filter, last_stats_.culled_hidden, last_stats_.culled_view),
+        fmt::format("draw calls   {}", last_stats_.draw_calls),
+    };
+
+    float x = mSize.x() - w - 10, y = 10;
+    float h = 2*padding + line*lines.size() + plot + line;
+
+    nvgBeginPath(vg);
+    nvgRoundedRect(vg, x, y, w, h, 3);
+    nvgFillColor(vg, ng::Color { 0.f, 0.f, 0.f, .7f });
+    nvgFill(vg);
+
+    nvgFontSize(vg, 14);
+    nvgFontFace(vg, "sans");
+    nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+    nvgFillColor(vg, ng::Color { 1.f, 1.f, 1.f, .9f });
+    for (size_t i = 0; i < lines.size(); ++i)
+        nvgText(vg, x + padding, y + padding + i*line, lines[i].c_str(), nullptr);
+
+    // histogram of the recent frame times, up to the slowest one (but at least 60 fps)
+    float   range   = std::max(frame_times_.max(), 1000.f / 60);
+    auto    counts  = frame_times_.histogram(bins, range);
+    size_t  highest = std::max<size_t>(*std::max_element(counts.begin(), counts.end()), 1);
+
+    float   px = x + padding, py = y + padding + line*lines.size();
+    float   bw = (w - 2*padding) / bins;
+    nvgBeginPath(vg);
+    for (size_t b = 0; b < bins; ++b)
+    {
+        float bh = plot * counts[b] / highest;
+        nvgRect(vg, px + b*bw, py + plot - bh, std::max(bw - 1, 1.f), bh);
+    }
+    nvgFillColor(vg, ng::Color { .4f, .8f, 1.f, .9f });
+    nvgFill(vg);
+
+    nvgFontSize(vg, 12);
+    nvgFillColor(vg, ng::Color { 1.f, 1.f, 1.f, .7f });
+    nvgText(vg, px, py + plot + 2, "0", nullptr);
+    nvgTextAlign(vg, NVG_ALIGN_RIGHT | NVG_ALIGN_TOP);
+    nvgText(vg, x + w - padding, py + plot + 2, fmt::format("{:.1f} ms", range).c_str(), nullptr);
+}
+
+void
+profvis::ProfileCanvas::
+draw_heatmap(NVGcontext* ctx)
+{
+    NVGcontext* vg = ctx;
+
+    // the time axis follows the view, the rank axis is fit to the widget
+    View    v       = view(mTransform, mPos, mSize);
+    double  range   = profile_.max_time() - profile_.min_time();
+    Profile::Time begin = std::max(0., profile_.min_time() + (v.min.x() - init_hoffset) / width * range);
+    Profile::Time end   = std::max(0., profile_.min_time() + (v.max.x() - init_hoffset) / width * range);
+    size_t  columns = std::max(mSize.x(), 1);
+    size_t  rows    = std::min<size_t>(std::max(mSize.y(), 1), profile_.events.size());
+
+    if (heatmap_dirty_ || begin != heatmap_begin_ || end != heatmap_end_ ||
+        columns != heatmap_.columns || rows != heatmap_.rows)
+    {
+        heatmap_ = compute_heatmap(profile_, begin, end, columns, rows, heatmap_depth, heatmap_name, order_);
+        heatmap_begin_ = begin;
+        heatmap_end_   = end;
+        heatmap_dirty_ = false;
+
+        colorize(heatmap_, heatmap_name, heatmap_pixels_);
+        upload_image(ctx, heatmap_image_, heatmap_, heatmap_pixels_);
+    }
+
+    if (heatmap_image_ == -1 || heatmap_pixels_.empty())
+        return;
+
+    nvgBeginPath(vg);
+    nvgRect(vg, 0, 0, mSize.x(), mSize.y());
+    nvgFillPaint(vg, nvgImagePattern(vg, 0, 0, mSize.x(), mSize.y(), 0, heatmap_image_, 1));
+    nvgFill(vg);
+}
+
+void
+profvis::ProfileCanvas::
+colorize(const Heatmap& h, size_t name, std::vector<unsigned char>& pixels) const
+{
+    pixels.assign(4 * h.columns * h.rows, 0);
+    for (size_t i = 0; i < h.values.size(); ++i)
+    {
+        float   value = h.values[i];
+        if (value == 0)
+            continue;
+
+        ng::Color c;
+        if (name == Heatmap::dominant)
+        {
+            if (hide[h.ids[i]])
+                continue;
+            c = colors_[h.ids[i]];
+            c.a() = value;
+        } else          // black through red and yellow to white
+            c = ng::Color { std::min(1.f, 3*value), std::min(1.f, std::max(0.f, 3*value - 1)),
+                            std::min(1.f, std::max(0.f, 3*value - 2)), 1.f };
+
+        for (size_t k = 0; k < 4; ++k)
+            pixels[4*i + k] = static_cast<unsigned char>(255 * c[k]);
+    }
+}
+
+void
+profvis::ProfileCanvas::
+upload_image(NVGcontext* ctx, int& image, const Heatmap& h, const std::vector<unsigned char>& pixels)
+{
+    NVGcontext* vg = ctx;
+
+    if (image != -1)
+    {
+        int w, h_;
+        nvgImageSize(vg, image, &w, &h_);
+        if (pixels.empty() || w != int(h.columns) || h_ != int(h.rows))
+        {
+            nvgDeleteImage(vg, image);
+            image = -1;
+        }
+    }
+
+    if (pixels.empty())
+        return;
+
+    if (image == -1)
+        image = nvgCreateImageRGBA(vg, h.columns, h.rows, NVG_IMAGE_NEAREST, &pixels[0]);
+    else
+        nvgUpdateImage(vg, image, &pixels[0]);
+}
+
+void
+profvis::ProfileCanvas::
+draw_overview(NVGcontext* ctx)
+{
+    NVGcontext* vg = ctx;
+
+    if (overview_dirty_)
+    {
+        colorize(overview_, Heatmap::dominant, overview_pixels_);
+        upload_image(ctx, overview_image_, overview_, overview_pixels_);
+        overview_dirty_ = false;
+    }
+
+    float y = mSize.y() - overview_height;
+
+    nvgBeginPath(vg);
+    nvgRect(vg, 0, y, mSize.x(), overview_height);
+    nvgFillColor(vg, ng::Color { 0.f, 0.f, 0.f, .8f });
+    nvgFill(vg);
+
+    if (overview_image_ != -1)
+    {
+        nvgBeginPath(vg);
+        nvgRect(vg, 0, y, mSize.x(), overview_height);
+        nvgFillPaint(vg, nvgImagePattern(vg, 0, y, mSize.x(), overview_height, 0, overview_image_, 1));
+        nvgFill(vg);
+    }
+
+    // the brush: time range of the main view
+    float begin, end;
+    brush(begin, end);
+
+    nvgBeginPath(vg);
+    nvgRect(vg, begin, y + 1, std::max(end - begin, 2.f), overview_height - 2);
+    nvgFillColor(vg, ng::Color { 1.f, 1.f, 1.f, .15f });
+    nvgFill(vg);
+    nvgStrokeColor(vg, ng::Color { 1.f, 1.f, 1.f, 1.f });
+    nvgStrokeWidth(vg, 1.);
+    nvgStroke(vg);
+}
+
+void
+profvis::ProfileCanvas::
+draw_concurrency(NVGcontext* ctx)
+{
+    NVGcontext* vg = ctx;
+
+    nvgBeginPath(vg);
+    nvgRect(vg, 0, 0, mSize.x(), concurrency_height);
+    nvgFillColor(vg, ng::Color { 0.f, 0.f, 0.f, .8f });
+    nvgFill(vg);
+
+    // the areas only change with the time axis of the view, not on the redraws in between
+    std::array<float, 5> current {{ mTransform[0], mTransform[4], float(mPos.x()), float(mSize.x()), concurrency_height }};
+    if (concurrency_dirty_ || current != concurrency_view_)
+    {
+        concurrency_view_  = current;
+        concurrency_dirty_ = false;
+        stack_concurrency();
+    }
+
+    for (auto& area : concurrency_areas_)
+    {
         nvgBeginPath(vg);
+        nvgMoveTo(vg, area.outline[0].x(), area.outline[0].y());
+        for (size_t i = 1; i < area.outline.size(); ++i)
+            nvgLineTo(vg, area.outline[i].x(), area.outline[i].y());
+        nvgClosePath(vg);
+        nvgFillColor(vg, colors_[area.id]);
+        nvgFill(vg);
+        ++stats_.draw_calls;
+    }
+
+    std::string text = fmt::format("{} ranks", profile_.events.size());
+    nvgFontSize(vg, 12);
+    nvgFontFace(vg, "sans");
+    nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+    nvgFillColor(vg, ng::Color { 1.f, 1.f, 1.f, .8f });
+    nvgText(vg, 5, 2, text.c_str(), nullptr);
+}
+
+void
+profvis::ProfileCanvas::
+stack_concurrency()
+{
+    concurrency_areas_.clear();
+
+    View    v       = view(mTransform, mPos, mSize);
+    double  range   = profile_.max_time() - profile_.min_time();
+    Profile::Time begin = std::max(0., profile_.min_time() + (v.min.x() - init_hoffset) / width * range);
+    Profile::Time end   = std::max(0., profile_.min_time() + (v.max.x() - init_hoffset) / width * range);
+    begin = std::max(begin, profile_.min_time());
+    end   = std::min(end,   profile_.max_time());
+
+    if (end <= begin || profile_.events.empty())
+        return;
+
+    // buckets of about two pixels, a power of two microseconds long, so that zooming out only merges them
+    Profile::Time bucket = 1;
+    while (bucket < (end - begin) / std::max(mSize.x() / 2., 1.))
+        bucket *= 2;
+
+    if (concurrency_.bucket < bucket && concurrency_.covers(begin, end))
+        concurrency_ = coarsen(concurrency_, bucket / concurrency_.bucket);
+    else if (concurrency_.bucket != bucket || !concurrency_.covers(begin, end))
+    {
+        // a view's width of margin on either side, so that panning doesn't recompute
+        Profile::Time span  = end - begin;
+        Profile::Time first = std::max(begin > span ? begin - span : 0, profile_.min_time()) / bucket * bucket;
+        Profile::Time last  = std::min(end + span, profile_.max_time());
+        concurrency_ = compute_concurrency(profile_, first, bucket, (last - first) / bucket + 1, true);
+    }
+
+    auto& c = concurrency_;
+    size_t b0 = (begin - c.begin) / c.bucket;
+    size_t b1 = std::min(c.buckets, (end - c.begin + c.bucket - 1) / c.bucket);
+    if (b1 <= b0)
+        return;
+
+    auto x = [this,&c](size_t b) { return mTransform[0] * time_to_x(c.begin + b * c.bucket) + mTransform[4] - mPos.x(); };
+    float scale = (concurrency_height - 2) / profile_.events.size();       // all the ranks fill the strip
+    float bottom = concurrency_height - 1;
+
+    // one area per name, on top of the previous ones
+    std::vector<float> base(b1 - b0, 0);
+    for (size_t id = 0; id < c.names; ++id)
+    {
+        if (hide[id])
+            continue;
+
+        bool any = false;
+        for (size_t b = b0; b < b1 && !any; ++b)
+            any = c(id, b) > 0;
+        if (!any)
+            continue;
+
+        concurrency_areas_.push_back(Area { id, {} });
+        auto& outline = concurrency_areas_.back().outline;
+        outline.reserve(4 * (b1 - b0));
+        for (size_t b = b0; b < b1; ++b)
+        {
+            float top = bottom - scale * (base[b - b0] + c(id, b));
+            outline.emplace_back(x(b),     top);
+            outline.emplace_back(x(b + 1), top);
+        }
+        for (size_t b = b1; b-- > b0; )
+        {
+            outline.emplace_back(x(b + 1), bottom - scale * base[b - b0]);
+            outline.emplace_back(x(b),     bottom - scale * base[b - b0]);
+            base[b - b0] += c(id, b);
+        }
+    }
+}
+
+void
+profvis::ProfileCanvas::
+brush(float& begin, float& end) const
+{
+    // content x of the main view, mapped onto the width of the overview
+    View v = view(mTransform, mPos, mSize);
+    begin = (v.min.x() - init_hoffset) / width * mSize.x();
+    end   = (v.max.x() - init_hoffset) / width * mSize.x();
+}
+
+void
+profvis::ProfileCanvas::
+set_brush(float begin, float end)
+{
+    if (end - begin < 1)
+        return;
+
+    // scale and translate the time axis only, so that [begin,end] of the overview fills the widget
+    float cx0 = init_hoffset + begin / mSize.x() * width;
+    float cx1 = init_hoffset + end   / mSize.x() * width;
+    mTransform[0] = mSize.x() / (cx1 - cx0);
+    mTransform[4] = mPos.x() - mTransform[0] * cx0;
+}
+
+bool
+profvis::ProfileCanvas::
+in_overview(const nanogui::Vector2i& p) const
+{
+    return overview && !heatmap && p.y() - mPos.y() >= mSize.y() - overview_height;
+}
+
+bool
+profvis::ProfileCanvas::
+mouseButtonEvent(const nanogui::Vector2i &p, int button, bool down, int modifiers)
+{
+    if (button == GLFW_MOUSE_BUTTON_1 && (down ? in_overview(p) : brush_ != Brush::None))
+    {
+        float x = p.x() - mPos.x();
+        if (down)
+        {
+            brush(brush_begin_, brush_end_);
+            brush_        = x >= brush_begin_ && x <= brush_end_ ? Brush::Move : Brush::Draw;
+            brush_anchor_ = x;
+        } else
+            brush_ = Brush::None;
+        return true;
+    }
+
+    return Canvas::mouseButtonEvent(p, button, down, modifiers);
+}
+
+void
+profvis::ProfileCanvas::
+draw_lod(size_t rk, int level, size_t hoffset, size_t voffset, size_t height)
+{
+    auto&   rank = lod_.ranks[rk];
+    double  bw   = double(lod_.width(rk, level)) / (profile_.max_time() - profile_.min_time()) * width;
+
+    // only the buckets inside the view
+    double  first = std::max(0., (mView.min.x() - hoffset) / bw);
+    double  last  = (mView.max.x() - hoffset) / bw + 1;
+    if (last <= first)
+        return;
+
+    for (size_t d = 0; d < rank.depths.size(); ++d)
+    {
+        auto&   buckets = rank.depths[d][level];
+        size_t  b       = first;
+        size_t  end     = std::min<double>(last, buckets.size());
+
+        float   y = voffset + d*inset;
+        float   h = height - 2*d*inset;
+
+        while (b < end)
+        {
+            auto& bucket = buckets[b];
+            ++stats_.visited;
+            // buckets don't know the durations of their events, so only the name, rank, and depth are filtered
+            if (bucket.id == LevelOfDetail::Bucket::empty || hide[bucket.id] || !filter_.may_match(rk, d, bucket.id))
+            {
+                stats_.culled_hidden += bucket.id != LevelOfDetail::Bucket::empty;
+                ++b;
+                continue;
+            }
+
+            // merge the run of buckets with the same name and similar occupancy
+            size_t  e    = b + 1;
+            float   busy = bucket.busy;
+            while (e < end && buckets[e].id == bucket.id && std::abs(buckets[e].busy - bucket.busy) < .125f)
+                busy += buckets[e++].busy;
+            stats_.visited += e - b - 1;
+            ++stats_.rects;
+
+            batches_.add(d, bucket.id, busy / (e - b), { float(hoffset + b*bw), y, float((e - b)*bw), h });
+
+            b = e;
+        }
+    }
+}
+
+void
+profvis::ProfileCanvas::
+draw_events(const Profile::Events& events, size_t rk, size_t depth, size_t hoffset, size_t voffset, size_t height)
+{
+    // siblings are sorted and don't overlap, so their ends are sorted too
+    auto first = std::partition_point(events.begin(), events.end(),
+                                      [this](const Profile::Event& e) { return e.end < view_begin_; });
+    // in the automatic mode, events narrower than a pixel are merged with their neighbours
+    Profile::Time   cutoff = auto_filter ? pixel_time_ : time_filter;
+    MergedRun       run;
+    auto flush = [&]()
+    {
+        if (run.count == 0)
+            return;
+
+        float x = hoffset + (float(run.begin) - profile_.min_time()) / (profile_.max_time() - profile_.min_time()) * width;
+        float w = float(run.end - run.begin) / (profile_.max_time() - profile_.min_time()) * width;
+        float alpha = run.end > run.begin ? run.covered / (run.end - run.begin) : 1.f;
+        if (run.covered > 0)
+        {
+            batches_.add_mixed({ { x, float(voffset), w, float(height) },
+                                 { run.r / run.covered, run.g / run.covered, run.b / run.covered, alpha } });
+            ++stats_.rects;
+        }
+        run = MergedRun();
+    };
 
-        auto color = colors_[e.id];
+    auto it = first;
+    for (; it != events.end() && it->begin <= view_end_; ++it)
+    {
+        auto& e = *it;
+        ++stats_.visited;
+        if (e.end - e.begin < cutoff)
+        {
+            ++stats_.culled_filter;
+            if (auto_filter && shown(rk, depth, e))
+            {
+                if (run.count > 0 && (e.begin - run.end >= cutoff || e.end - run.begin >= cutoff))
+                    flush();
+                run.add(e, colors_[e.id]);
+            }
+            continue;
+        }
+        flush();
 
         float x = hoffset + (float(e.begin) - profile_.min_time()) / (profile_.max_time() - profile_.min_time()) * width;
         float y = voffset;
         float w = float(e.end - e.begin) / (profile_.max_time() - profile_.min_time()) * width;
         float h = height;
 
-        if (!hide[e.id])
+        if (shown(rk, depth, e))
         {
-            nvgRect(vg, x, y, w, h);
-            //fmt::print("Event ({}, {}, {})\n", e.name, e.begin, e.end);
-            //fmt::print("Rectangle ({}, {}, {}, {})\n", x, y, w, h);
-            //nvgStrokeColor(vg, color);
-            //nvgStrokeWidth(vg, 1.0f);
-            nvgFillColor(vg, color);
-            nvgFill(vg);
-            //nvgStroke(vg);
+            batches_.add(depth, e.id, 1.f, { x, y, w, h });
+            ++stats_.rects;
+        } else
+            ++stats_.culled_hidden;
+
+        draw_events(e.events, rk, depth + 1, hoffset, voffset + inset, height - 2*inset);
+    }
+    flush();
+
+    stats_.culled_view += (first - events.begin()) + (events.end() - it);
+}
+
+void
+profvis::ProfileCanvas::
+draw_batches(NVGcontext* ctx)
+{
+    NVGcontext* vg = ctx;
+
+    batches_.for_each([this,vg](size_t id, float alpha, const std::vector<RectBatches::Rect>& rects)
+    {
+        nvgBeginPath(vg);
+        for (auto& r : rects)
+            nvgRect(vg, r.x, r.y, r.w, r.h);
+
+        auto color = colors_[id];
+        color.a() *= alpha;
+        nvgFillColor(vg, color);
+        nvgFill(vg);
+    });
+
+    batches_.for_each_mixed([vg](const float* color, const std::vector<RectBatches::Rect>& rects)
+    {
+        nvgBeginPath(vg);
+        for (auto& r : rects)
+            nvgRect(vg, r.x, r.y, r.w, r.h);
+        nvgFillColor(vg, nvgRGBAf(color[0], color[1], color[2], color[3]));
+        nvgFill(vg);
+    });
+
+    batches_.clear();
+}
+
+void
+profvis::ProfileCanvas::
+draw_labels(NVGcontext* ctx)
+{
+    NVGcontext* vg = ctx;
+
+    // rows too thin for the text have no labels
+    if (base_height() * mTransform[3] < label_font_size)
+        return;
+
+    // The labels are collected over the whole view, rather than per tile, so that the labels of wide events aren't
+    // repeated or cut at the tile edges; they're kept for a margin of a view around it, until it zooms or leaves it.
+    View v = view(mTransform, mPos, mSize);
+    if (labels_dirty_ || mTransform[0] != labels_scale_.x() || mTransform[3] != labels_scale_.y() ||
+        v.min.x() < labels_region_.min.x() || v.min.y() < labels_region_.min.y() ||
+        v.max.x() > labels_region_.max.x() || v.max.y() > labels_region_.max.y())
+    {
+        ng::Vector2f margin = v.max - v.min;
+        labels_region_.min  = v.min - margin;
+        labels_region_.max  = v.max + margin;
+        labels_scale_       = ng::Vector2f(mTransform[0], mTransform[3]);
+        labels_dirty_       = false;
+        collect_labels(labels_region_);
+    }
+    if (labels_.empty())
+        return;
+
+    nvgSave(vg);
+    nvgIntersectScissor(vg, 0, 0, mSize.x(), mSize.y());
+    nvgFontSize(vg, label_font_size);
+    nvgFontFace(vg, "sans");
+    nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
+
+    const float padding = 3;
+    for (auto& l : labels_)
+    {
+        float x0 = mTransform[0] * l.x + mTransform[4] - mPos.x();
+        float x1 = mTransform[0] * (l.x + l.w) + mTransform[4] - mPos.x();
+        float y0 = mTransform[3] * l.y + mTransform[5] - mPos.y();
+        float y1 = mTransform[3] * (l.y + l.h) + mTransform[5] - mPos.y();
+        if (x1 < 0 || x0 > mSize.x() || y1 < 0 || y0 > mSize.y())
+            continue;
+        x0 = std::max(x0, 0.f);                 // keep the label in view when the event starts or ends off-screen
+        x1 = std::min(x1, float(mSize.x()));
+
+        float available = x1 - x0 - 2*padding;
+        if (available < label_width - 2*padding || y1 - y0 < label_font_size)
+            continue;
+
+        auto& text = label(vg, l.id, available);
+        if (text.empty())
+            continue;
+
+        nvgFillColor(vg, colors_[l.id].contrastingColor());
+        nvgText(vg, x0 + padding, (y0 + y1)/2, text.c_str(), nullptr);
+        ++stats_.draw_calls;
+    }
+
+    nvgRestore(vg);
+}
+
+void
+profvis::ProfileCanvas::
+collect_labels(const View& region)
+{
+    labels_.clear();
+
+    double          range   = profile_.max_time() - profile_.min_time();
+    Profile::Time   begin   = std::max(0., profile_.min_time() + (region.min.x() - init_hoffset) / width * range);
+    Profile::Time   end     = std::max(0., profile_.min_time() + (region.max.x() - init_hoffset) / width * range);
+
+    // the shortest event wide enough for a label; the EventIndex skips whole blocks of shorter ones
+    Profile::Time   shortest = std::ceil(label_width / mTransform[0] / width * range);
+    if (!auto_filter)
+        shortest = std::max<Profile::Time>(shortest, time_filter);
+
+    double  pitch = base_height() + rank_gap;
+    long    first = std::max<long>(std::floor((region.min.y() - init_voffset) / pitch), 0);
+    long    last  = std::min<long>(std::floor((region.max.y() - init_voffset) / pitch) + 1, order_.size());
+    for (long row = first; row < last; ++row)
+    {
+        size_t  rk      = order_[row];
+        auto&   depths  = index_.ranks[rk];
+        for (size_t depth = 0; depth < depths.size(); ++depth)
+        {
+            auto&   d       = depths[depth];
+            float   y       = row_to_y(row) + depth * inset;
+            float   height  = base_height() - 2. * depth * inset;
+
+            // the first event that ends at or after begin
+            size_t i = std::upper_bound(d.begins.begin(), d.begins.end(), begin) - d.begins.begin();
+            if (i > 0 && d.events[i - 1]->end >= begin)
+                --i;
+
+            for (i = d.next_longer(i, shortest); i < d.events.size() && d.begins[i] <= end; i = d.next_longer(i + 1, shortest))
+            {
+                auto& e = *d.events[i];
+                if (!shown(rk, depth, e))
+                    continue;
+
+                // leaves are labelled in the middle, parents in the band above their children
+                float x = time_to_x(e.begin);
+                float w = time_to_x(e.end) - x;
+                if (e.events.empty())
+                    labels_.push_back(Label { x, y, w, height, e.id });
+                else if (inset * mTransform[3] >= label_font_size)
+                    labels_.push_back(Label { x, y, w, float(inset), e.id });
+            }
         }
+    }
+}
 
-        draw_events(ctx, e.events, hoffset, voffset + inset, height - 2*inset);
+const std::string&
+profvis::ProfileCanvas::
+label(NVGcontext* ctx, size_t id, float available)
+{
+    // widths are quantized to 8 pixels, so that the measurements can be reused
+    size_t bucket = std::min<size_t>(available / 8, (1 << 16) - 1);
+    size_t key    = (id << 16) | bucket;
+    auto it = truncated_labels_.find(key);
+    if (it != truncated_labels_.end())
+        return it->second;
+
+    NVGcontext*         vg       = ctx;
+    const std::string&  name     = profile_.names[id];
+    const std::string   ellipsis = "\u2026";
+    float               width    = bucket * 8;
+
+    auto fits = [vg,width](const std::string& s) { return nvgTextBounds(vg, 0, 0, s.c_str(), nullptr, nullptr) <= width; };
+
+    std::string text;
+    if (fits(name))
+        text = name;
+    else
+    {
+        // longest prefix that fits together with the ellipsis
+        size_t lo = 0, hi = name.size();
+        while (lo < hi)
+        {
+            size_t mid = (lo + hi + 1) / 2;
+            if (fits(name.substr(0, mid) + ellipsis))
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        if (lo > 0)
+            text = name.substr(0, lo) + ellipsis;
     }
+
+    return truncated_labels_[key] = text;
 }
 
 bool
 profvis::ProfileCanvas::
 mouseMotionEvent(const nanogui::Vector2i &p, const nanogui::Vector2i &rel, int button, int modifiers)
 {
+    if (brush_ != Brush::None)
+    {
+        float x = p.x() - mPos.x();
+        if (brush_ == Brush::Move)
+            set_brush(brush_begin_ + x - brush_anchor_, brush_end_ + x - brush_anchor_);
+        else
+            set_brush(std::min(x, brush_anchor_), std::max(x, brush_anchor_));
+        return true;
+    }
+
     if (Canvas::mouseMotionEvent(p,rel,button,modifiers))
         return true;
 
@@ -73,18 +852,41 @@ mouseMotionEvent(const nanogui::Vector2i &p, const nanogui::Vector2i &rel, int b
     float x, y;
     nvgTransformPoint(&x, &y, &inverse[0], p[0], p[1]);
 
-    // translate y to rank
-    int rk = floor((y - init_voffset)/(base_height() + rank_gap));
+    // translate y to row, and row to rank
+    int row = floor((y - init_voffset)/(base_height() + rank_gap));
+    int rk  = row >= 0 && row < int(order_.size()) ? order_[row] : -1;
 
     Profile::Event dummy { static_cast<size_t>(-1), 0, 0 };
 
+    if (in_overview(p))
+    {
+        callback_(dummy, -1);
+        return false;
+    }
+
+    if (heatmap)
+    {
+        // the heatmap stretches all the ranks over the height of the widget
+        row = std::floor(float(p.y() - mPos.y()) / mSize.y() * profile_.events.size());
+        rk  = row >= 0 && row < int(order_.size()) ? order_[row] : -1;
+        Profile::Time time = profile_.min_time() + (x - init_hoffset) / width * (profile_.max_time() - profile_.min_time());
+        const Profile::Event* event = nullptr;
+        if (rk >= 0 && rk < profile_.events.size())
+            event = search_events(time, rk, heatmap_depth);
+        if (event)
+            callback_(*event, rk);
+        else
+            callback_(dummy, -1);
+        return event != nullptr;
+    }
+
     if (rk < 0 || rk > profile_.events.size() - 1)
     {
         callback_(dummy, -1);
         return false;
     }
 
-    float rel_y = y - init_voffset - rk*(base_height() + rank_gap);
+    float rel_y = y - row_to_y(row);
     if (rel_y > base_height())        // gap between ranks
     {
         callback_(dummy, -1);
@@ -101,7 +903,7 @@ mouseMotionEvent(const nanogui::Vector2i &p, const nanogui::Vector2i &rel, int b
         max_level = (base_height() - rel_y) / inset;
 
     // find the event
-    const Profile::Event* event = search_events(time, profile_.events[rk], 0, max_level);
+    const Profile::Event* event = search_events(time, rk, max_level);
     if (event)
     {
         callback_(*event, rk);
@@ -114,33 +916,258 @@ mouseMotionEvent(const nanogui::Vector2i &p, const nanogui::Vector2i &rel, int b
 }
 
 
-const profvis::Profile::Event*
+void
+profvis::ProfileCanvas::
+focus(const Occurrences::Occurrence& o)
+{
+    float x0 = time_to_x(o.begin);
+    float x1 = time_to_x(o.begin + o.duration);
+    float y  = rank_to_y(o.rank) + base_height() / 2.;
+
+    // keep the zoom, unless the event would be wider than 80% of the view, or narrower than a few pixels
+    float& sx = mTransform[0];
+    float  w  = (x1 - x0) * sx;
+    if (x1 > x0 && w > .8 * mSize.x())
+        sx = .8 * mSize.x() / (x1 - x0);
+    else if (x1 > x0 && w < 4)
+        sx = .1 * mSize.x() / (x1 - x0);
+
+    mTransform[4] = mPos.x() + mSize.x() / 2. - sx * (x0 + x1) / 2;
+    mTransform[5] = mPos.y() + mSize.y() / 2. - mTransform[3] * y;
+
+    focused_ = true;
+    focus_   = o;
+    callback_(event(o), o.rank);
+}
+
+profvis::Profile::Time
 profvis::ProfileCanvas::
-search_events(Profile::Time time, const Profile::Events& events, int level, int max_level) const
+center_time() const
 {
-    if (level > max_level)
-        return nullptr;
+    View v = view(mTransform, mPos, mSize);
+    double range = profile_.max_time() - profile_.min_time();
+    return std::max(0., profile_.min_time() + ((v.min.x() + v.max.x()) / 2 - init_hoffset) / width * range);
+}
+
+void
+profvis::ProfileCanvas::
+draw_focus(NVGcontext* ctx)
+{
+    NVGcontext* vg = ctx;
+
+    // the rectangle of the event, as draw_events() lays it out, in widget coordinates
+    float x0 = time_to_x(focus_.begin);
+    float x1 = time_to_x(focus_.begin + focus_.duration);
+    float y0 = rank_to_y(focus_.rank) + focus_.depth * inset;
+    float y1 = y0 + base_height() - 2 * focus_.depth * inset;
+
+    float l = mTransform[0] * x0 + mTransform[4] - mPos.x();
+    float r = mTransform[0] * x1 + mTransform[4] - mPos.x();
+    float t = mTransform[3] * y0 + mTransform[5] - mPos.y();
+    float b = mTransform[3] * y1 + mTransform[5] - mPos.y();
+
+    nvgBeginPath(vg);
+    nvgRect(vg, l - 2, t - 2, std::max(r - l, 1.f) + 4, b - t + 4);
+    nvgStrokeColor(vg, ng::Color { 1.f, 1.f, 0.f, 1.f });
+    nvgStrokeWidth(vg, 2.);
+    nvgStroke(vg);
+}
+
+void
+profvis::ProfileCanvas::
+draw_messages(NVGcontext* ctx)
+{
+    NVGcontext* vg = ctx;
+
+    if (messages_.levels[0].flows.empty())
+        return;
+
+    View    v       = view(mTransform, mPos, mSize);
+    double  range   = profile_.max_time() - profile_.min_time();
+    double  begin   = std::max(0., profile_.min_time() + (v.min.x() - init_hoffset) / width * range);
+    double  end     = std::max(0., profile_.min_time() + (v.max.x() - init_hoffset) / width * range);
+
+    // bundles of messages sent within a few pixels of each other
+    size_t  level   = messages_.level((end - begin) / std::max(mSize.x(), 1) * 4);
+
+    auto x = [this](Profile::Time t) { return mTransform[0] * time_to_x(t) + mTransform[4] - mPos.x(); };
+    auto y = [this](size_t rk)       { return mTransform[3] * (rank_to_y(rk) + base_height() / 2.) + mTransform[5] - mPos.y(); };
+
+    // single messages go into one path; bundles into one path per width, which grows with the log of the count
+    const size_t widths = 6;
+    std::vector<std::vector<std::pair<ng::Vector2f, ng::Vector2f>>> bundles(widths);
+
+    nvgBeginPath(vg);
+    messages_.visit(level, begin, end, [&](const Messages::Flow& f)
+    {
+        float y0 = y(f.src), y1 = y(f.dst);
+        if ((y0 < 0 && y1 < 0) || (y0 > mSize.y() && y1 > mSize.y()))
+        {
+            ++stats_.culled_view;
+            return;
+        }
+        ++stats_.visited;
+
+        ng::Vector2f from(x(f.send), y0), to(x(f.recv), y1);
+        if (f.count > 1)
+        {
+            bundles[std::min<size_t>(std::log2(f.count), widths - 1)].emplace_back(from, to);
+            return;
+        }
+
+        nvgMoveTo(vg, from.x(), from.y());
+        nvgLineTo(vg, to.x(), to.y());
+
+        // arrowhead
+        ng::Vector2f d = to - from;
+        float length = d.norm();
+        if (length < 8)
+            return;
+        d /= length;
+        ng::Vector2f n(-d.y(), d.x());
+        nvgMoveTo(vg, to.x() - 6*d.x() + 3*n.x(), to.y() - 6*d.y() + 3*n.y());
+        nvgLineTo(vg, to.x(), to.y());
+        nvgLineTo(vg, to.x() - 6*d.x() - 3*n.x(), to.y() - 6*d.y() - 3*n.y());
+    });
+    nvgStrokeColor(vg, ng::Color { 1.f, 1.f, 1.f, .7f });
+    nvgStrokeWidth(vg, 1.);
+    nvgStroke(vg);
+    ++stats_.draw_calls;
 
-    for (auto& e : events)      // TODO: binary search
+    for (size_t w = 0; w < widths; ++w)
     {
-        if (e.end - e.begin < time_filter) continue;
+        if (bundles[w].empty())
+            continue;
 
-        if (time <= e.end && time >= e.begin)
+        nvgBeginPath(vg);
+        for (auto& b : bundles[w])
         {
-            // search children
-            const Profile::Event* event = search_events(time, e.events, level + 1, max_level);
+            nvgMoveTo(vg, b.first.x(),  b.first.y());
+            nvgLineTo(vg, b.second.x(), b.second.y());
+        }
+        nvgStrokeColor(vg, ng::Color { 1.f, 1.f, 1.f, .5f });
+        nvgStrokeWidth(vg, 1. + w);
+        nvgStroke(vg);
+        ++stats_.draw_calls;
+    }
+}
+
+void
+profvis::ProfileCanvas::
+draw_path(NVGcontext* ctx)
+{
+    NVGcontext* vg = ctx;
+
+    View    v       = view(mTransform, mPos, mSize);
+    double  range   = profile_.max_time() - profile_.min_time();
+    double  begin   = profile_.min_time() + (v.min.x() - init_hoffset) / width * range;
+    double  end     = profile_.min_time() + (v.max.x() - init_hoffset) / width * range;
 
-            if (event)
-                return event;
+    auto x = [this](Profile::Time t) { return mTransform[0] * time_to_x(t) + mTransform[4] - mPos.x(); };
+    auto y = [this](size_t rk)       { return mTransform[3] * rank_to_y(rk) + mTransform[5] - mPos.y(); };
 
-            if (hide[e.id])
-                return nullptr;
+    // the segments are in time order, so the visible ones are consecutive
+    auto first = std::partition_point(path_.begin(), path_.end(),
+                                      [begin](const Collectives::Segment& s) { return s.end < begin; });
+    auto last  = std::partition_point(first, path_.end(),
+                                      [end](const Collectives::Segment& s) { return s.begin <= end; });
+    if (first == last)
+        return;
+    if (first != path_.begin())
+        --first;            // to connect from the rank before the view
 
-            return &e;
+    // a bar along the top of the rank, computing in one colour, in collectives in another; a line where the path changes ranks
+    float height = std::max(2.f, mTransform[3] * inset);
+    for (bool collective : { false, true })
+    {
+        nvgBeginPath(vg);
+        float right = -1;
+        for (auto it = first; it != last; ++it)
+        {
+            if (it->collective != collective)
+                continue;
+            float l = x(it->begin), r = x(it->end), t = y(it->rank);
+            if (r < right + .5 && r - l < .5)       // narrower than a pixel, next to the previous one
+                continue;
+            nvgRect(vg, l, t - height, std::max(r - l, 1.f), height);
+            right = r;
         }
+        nvgFillColor(vg, collective ? ng::Color { 1.f, .3f, .2f, .9f } : ng::Color { 1.f, .8f, 0.f, .9f });
+        nvgFill(vg);
+        ++stats_.draw_calls;
     }
 
-    return nullptr;
+    nvgBeginPath(vg);
+    for (auto it = first; it + 1 != last && it + 1 != path_.end(); ++it)
+        if (it->rank != (it + 1)->rank)
+        {
+            float cx = x(it->end);
+            nvgMoveTo(vg, cx, y(it->rank) - height / 2);
+            nvgLineTo(vg, cx, y((it + 1)->rank) - height / 2);
+        }
+    nvgStrokeColor(vg, ng::Color { 1.f, .8f, 0.f, .9f });
+    nvgStrokeWidth(vg, 1.5);
+    nvgStroke(vg);
+    ++stats_.draw_calls;
+}
+
+void
+profvis::ProfileCanvas::
+set_order(std::vector<size_t> order)
+{
+    order_ = std::move(order);
+    row_of_.resize(order_.size());
+    row_events_.assign(order_.size() + 1, 0);
+    for (size_t row = 0; row < order_.size(); ++row)
+    {
+        row_of_[order_[row]]  = row;
+        row_events_[row + 1]  = row_events_[row] + profile_.events[order_[row]].size();
+    }
+    damage();
+}
+
+void
+profvis::ProfileCanvas::
+select(nanogui::Vector2f min, nanogui::Vector2f max)
+{
+    // a click, not a selection
+    if ((max.x() - min.x()) * mTransform[0] < 3 || (max.y() - min.y()) * mTransform[3] < 3)
+        return;
+
+    // ranks whose band intersects the box
+    double  pitch = base_height() + rank_gap;
+    long    first = std::ceil((min.y() - init_voffset - base_height()) / pitch);
+    long    last  = std::floor((max.y() - init_voffset) / pitch) + 1;
+    first = std::max(first, 0l);
+    last  = std::min(last, long(profile_.events.size()));
+    if (first >= last)
+        return;
+
+    double  range = profile_.max_time() - profile_.min_time();
+    Profile::Time begin = std::max(0., profile_.min_time() + (min.x() - init_hoffset) / width * range);
+    Profile::Time end   = std::max(0., profile_.min_time() + (max.x() - init_hoffset) / width * range);
+
+    selection_callback_(region_stats(regions_, index_, begin, end,
+                                     std::vector<size_t>(order_.begin() + first, order_.begin() + last)));
+}
+
+const profvis::Profile::Event*
+profvis::ProfileCanvas::
+search_events(Profile::Time time, size_t rk, int max_level) const
+{
+    // at most one event per depth contains time, and it's nested in the one above
+    const Profile::Event* found = nullptr;
+    for (int depth = 0; depth <= max_level; ++depth)
+    {
+        auto* e = index_.find(rk, depth, time);
+        if (!e || (!auto_filter && e->end - e->begin < time_filter))
+            break;          // children are shorter still
+
+        if (shown(rk, depth, *e))
+            found = e;
+    }
+
+    return found;
 }
 
 void
@@ -153,6 +1180,8 @@ randomize_colors()
 
     for (auto& c : colors_)
         c = ng::Color { rand(gen), rand(gen), rand(gen), 1. };
+
+    damage();
 }
 
 profvis::NameColors
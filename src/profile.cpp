@@ -1,6 +1,8 @@
 #include <profvis/profile.h>
+#include <profvis/parallel.h>
 #include <iterator>
 #include <algorithm>
+#include <cstdlib>
 
 #include <iostream>
 
@@ -19,9 +21,18 @@ static inline std::string trim(std::string s) {
 profvis::Profile::Time
 profvis::parse_time(std::string stamp)
 {
-    Profile::Time hours, minutes, seconds;
-    Profile::Time result;
-    sscanf(stamp.c_str(), "%ld:%ld:%ld.%ld", &hours, &minutes, &seconds, &result);
+    return parse_time(stamp.c_str());
+}
+
+profvis::Profile::Time
+profvis::parse_time(const char* stamp)
+{
+    // hours:minutes:seconds.microseconds
+    char* end;
+    Profile::Time hours   = std::strtoul(stamp,   &end, 10);
+    Profile::Time minutes = std::strtoul(end + 1, &end, 10);
+    Profile::Time seconds = std::strtoul(end + 1, &end, 10);
+    Profile::Time result  = std::strtoul(end + 1, &end, 10);
 
     seconds += 60*(minutes + 60*hours);
     result +=  1000000 * seconds;
@@ -38,9 +49,11 @@ read_profile(std::string fn)
     zstr::ifstream                  in(fn);
     std::string                     line;
     std::vector<Profile::Event*>    event_stack;
+    std::vector<size_t>             endpoint_stack;     // endpoint of each open event, or -1
     size_t                          max_depth = 0;
     Profile::Time                   max_time = std::numeric_limits<Profile::Time>::min();
     Profile::Time                   min_time = std::numeric_limits<Profile::Time>::max();
+    const size_t                    no_endpoint = static_cast<size_t>(-1);
     while(std::getline(in, line))
     {
         std::istringstream ins(line);
@@ -51,6 +64,23 @@ read_profile(std::string fn)
         ins >> rank >> time_stamp >> name;
         auto time = parse_time(time_stamp);
 
+        // optional attributes of point-to-point calls: dst=, src=, or peer= (a receive if the name has Recv), and tag=
+        long peer = -1, tag = 0;
+        int  send = -1;
+        std::string attribute;
+        while (ins >> attribute)
+        {
+            auto eq = attribute.find('=');
+            if (eq == std::string::npos)
+                continue;
+            auto key   = attribute.substr(0, eq);
+            long value = std::strtol(attribute.c_str() + eq + 1, nullptr, 10);
+            if (key == "dst")       { peer = value; send = 1; }
+            else if (key == "src")  { peer = value; send = 0; }
+            else if (key == "peer") { peer = value; }
+            else if (key == "tag")  { tag  = value; }
+        }
+
         if (time > max_time) max_time = time;
         if (time < min_time) min_time = time;
 
@@ -67,6 +97,9 @@ read_profile(std::string fn)
                 max_depth = event_stack.size();
             event_stack.back()->end = time;
             event_stack.pop_back();
+            if (endpoint_stack.back() != no_endpoint)
+                profile.endpoints[endpoint_stack.back()].end = time;
+            endpoint_stack.pop_back();
         } else
         {
             if (rank >= profile.events.size())
@@ -90,6 +123,15 @@ read_profile(std::string fn)
 
             level->emplace_back(Profile::Event { id, time, time });
             event_stack.push_back(&level->back());
+
+            endpoint_stack.push_back(no_endpoint);
+            if (peer >= 0)
+            {
+                if (send == -1)
+                    send = name.find("Recv") == std::string::npos && name.find("recv") == std::string::npos;
+                endpoint_stack.back() = profile.endpoints.size();
+                profile.endpoints.push_back(Profile::Endpoint { std::uint32_t(rank), std::uint32_t(peer), std::int32_t(tag), send == 1, time, time });
+            }
         }
     }
 
@@ -97,6 +139,8 @@ read_profile(std::string fn)
     profile.max_time_   = max_time;
     profile.min_time_   = min_time;
 
+    compute_times(profile);
+
     return profile;
 }
 
@@ -118,6 +162,7 @@ read_caliper(std::string fn, bool mpi_functions)
         size_t offset;
         size_t duration;
         int type = -1; size_t id;
+        long peer = -1, tag = 0; bool send = true;
         while(std::getline(iss, field, ','))
         {
             auto eq_pos = field.find('=');
@@ -143,12 +188,28 @@ read_caliper(std::string fn, bool mpi_functions)
                 duration = std::stol(value);
             else if (name == "time.offset")
                 offset = std::stol(value);
+            else if (name == "mpi.msg.dst")
+            {
+                peer = std::stol(value);
+                send = true;
+            }
+            else if (name == "mpi.msg.src")
+            {
+                peer = std::stol(value);
+                send = false;
+            }
+            else if (name == "mpi.msg.tag")
+                tag = std::stol(value);
         }
 
         if (type == 1)
         {
             events.emplace_back(rank, offset - duration, id, true);
             events.emplace_back(rank, offset, id, false);
+
+            if (peer >= 0)
+                profile.endpoints.push_back(Profile::Endpoint { std::uint32_t(rank), std::uint32_t(peer), std::int32_t(tag), send,
+                                                                offset - duration, offset });
         }
     }
 
@@ -193,5 +254,118 @@ read_caliper(std::string fn, bool mpi_functions)
     profile.max_time_   = max_time;
     profile.min_time_   = min_time;
 
+    compute_times(profile);
+
     return profile;
 }
+
+namespace
+{
+
+using Times     = profvis::Profile::Times;
+using RankTimes = profvis::Profile::RankTimes;
+
+// Times of the names on one rank at a time: dense over the names, but reset only where a rank touched them.
+struct RankAccumulator
+{
+            RankAccumulator(size_t n):
+                times(n, Times { 0, 0 }), totals(n, Times { 0, 0 }), open(n, 0), seen(n, false)    {}
+
+    // returns the time covered by the events
+    profvis::Profile::Time  add(profvis::Profile::Events& events)
+    {
+        profvis::Profile::Time covered = 0;
+        for (auto& e : events)
+        {
+            if (!seen[e.id])
+            {
+                seen[e.id] = true;
+                touched.push_back(e.id);
+            }
+
+            auto duration = e.end - e.begin;
+            if (open[e.id]++ == 0)
+                times[e.id].inclusive += duration;
+            auto children = add(e.events);
+            --open[e.id];
+
+            e.exclusive = duration - std::min(children, duration);
+            times[e.id].exclusive += e.exclusive;
+            covered += duration;
+        }
+        return covered;
+    }
+
+    // moves the times of the rank into result, and adds them to the totals
+    void                    flush(std::vector<RankTimes>& result)
+    {
+        std::sort(touched.begin(), touched.end());
+        result.reserve(touched.size());
+        for (size_t id : touched)
+        {
+            result.push_back(RankTimes { id, times[id] });
+            totals[id].inclusive += times[id].inclusive;
+            totals[id].exclusive += times[id].exclusive;
+            times[id] = Times { 0, 0 };
+            seen[id]  = false;
+        }
+        touched.clear();
+    }
+
+    std::vector<Times>      times, totals;
+    std::vector<int>        open;           // enclosing events with the same name
+    std::vector<bool>       seen;
+    std::vector<size_t>     touched;
+};
+
+}
+
+const profvis::Profile::Times&
+profvis::Profile::
+times(size_t rk, size_t id) const
+{
+    static const Times none { 0, 0 };
+    auto& ts = rank_times_[rk];
+    auto  it = std::lower_bound(ts.begin(), ts.end(), id, [](const RankTimes& t, size_t id) { return t.id < id; });
+    return it != ts.end() && it->id == id ? it->times : none;
+}
+
+void
+profvis::
+compute_times(Profile& profile)
+{
+    size_t n = profile.names.size();
+    profile.times_.assign(n, Profile::Times { 0, 0 });
+    profile.rank_times_.assign(profile.events.size(), std::vector<RankTimes>());
+
+    // ranks are split into chunks, one accumulator each, whose totals are reduced at the end
+    size_t chunks = std::min<size_t>(profile.events.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::vector<Times>> totals(chunks);
+    parallel_for(chunks, [&](size_t c)
+    {
+        RankAccumulator accumulator(n);
+        for (size_t rk = c; rk < profile.events.size(); rk += chunks)
+        {
+            accumulator.add(profile.events[rk]);
+            accumulator.flush(profile.rank_times_[rk]);
+        }
+        totals[c].swap(accumulator.totals);
+    });
+
+    for (auto& t : totals)
+        for (size_t id = 0; id < n; ++id)
+        {
+            profile.times_[id].inclusive += t[id].inclusive;
+            profile.times_[id].exclusive += t[id].exclusive;
+        }
+}
+
+std::vector<profvis::Profile::Time>
+profvis::
+total_times(const Profile& profile)
+{
+    std::vector<Profile::Time> totals(profile.names.size());
+    for (size_t id = 0; id < totals.size(); ++id)
+        totals[id] = profile.times(id).inclusive;
+    return totals;
+}
@@ -0,0 +1,106 @@
+#include <limits>
+#include <algorithm>
+
+#include <opts/opts.h>
+
+#include <fmt/format.h>
+
+#include <profvis/stats.h>
+namespace pv = profvis;
+
+// Prints the same table as `tools/info.py show`.
+int main(int argc, char *argv[])
+{
+    using namespace opts;
+    Options ops;
+
+    bool help;
+    bool stats_only;
+    bool ranks_only;
+    bool percentiles;
+    pv::StatsOptions options;
+    ops
+        >> Option('h', "help",          help,               "show help")
+        >> Option('r', "regex",         options.regex,      "regular expression to apply")
+        >> Option('f', "full-name",     options.full_name,  "use full names")
+        >> Option(     "stats-only",    stats_only,         "show stats only")
+        >> Option(     "ranks-only",    ranks_only,         "don't show stats")
+        >> Option('p', "percentiles",   percentiles,        "show the percentiles of the durations")
+        >> Option('j', "threads",       options.threads,    "number of threads (default: all)")
+    ;
+
+    std::string     infn;
+    if (!ops.parse(argc,argv) || !(ops >> PosOption(infn)) || help)
+    {
+        fmt::print("Usage: {} FILE.prf [SEGMENT]\n", argv[0]);
+        fmt::print("\nShow the number of occurrences and total time spent in different segments of the profile\n\n");
+        fmt::print("{}", ops);
+        return 1;
+    }
+    ops >> PosOption(options.segment);
+
+    pv::ProfileStats stats;
+    try
+    {
+        stats = pv::compute_stats(infn, options);
+    } catch (std::exception& e)
+    {
+        fmt::print(stderr, "Error: {}\n", e.what());
+        return 1;
+    }
+
+    if (stats.unbalanced)
+        fmt::print("Warning: stack not empty at the end of the profile\n");
+
+    for (auto& x : stats.segments)
+    {
+        auto& ranks = x.second.ranks;
+
+        fmt::print("{}\n", x.first);
+        if (!stats_only)
+            for (auto& rk : ranks)
+                fmt::print("{:>10} {:>20} {:>20}\n", rk.first, rk.second.count, pv::format_time(rk.second.time));
+
+        if (ranks_only)
+            continue;
+
+        size_t          min_count = std::numeric_limits<size_t>::max(), max_count = 0, sum_count = 0;
+        pv::Profile::Time min_time = std::numeric_limits<pv::Profile::Time>::max(), max_time = 0, sum_time = 0;
+        for (auto& rk : ranks)
+        {
+            min_count  = std::min(min_count, rk.second.count);
+            max_count  = std::max(max_count, rk.second.count);
+            sum_count += rk.second.count;
+
+            // like info.py, only the ranks where the name has ended count towards the times
+            if (!rk.second.timed)
+                continue;
+            min_time  = std::min(min_time, rk.second.time);
+            max_time  = std::max(max_time, rk.second.time);
+            sum_time += rk.second.time;
+        }
+        if (min_time > max_time)
+            min_time = 0;
+
+        fmt::print("  Count:\n");
+        fmt::print("    min:  {:>21}\n", min_count);
+        fmt::print("    max:  {:>21}\n", max_count);
+        fmt::print("    sum:  {:>21}\n", sum_count);
+        fmt::print("  Time:\n");
+        fmt::print("    min:  {:>42}\n", pv::format_time(min_time));
+        fmt::print("    max:  {:>42}\n", pv::format_time(max_time));
+        fmt::print("    sum:  {:>42}\n", pv::format_time(sum_time));
+
+        if (percentiles)
+        {
+            auto& d = x.second.durations;
+            fmt::print("  Duration:\n");
+            fmt::print("    p50:  {:>42}\n", pv::format_time(d.quantile(.5)));
+            fmt::print("    p90:  {:>42}\n", pv::format_time(d.quantile(.9)));
+            fmt::print("    p99:  {:>42}\n", pv::format_time(d.quantile(.99)));
+            fmt::print("    max:  {:>42}\n", pv::format_time(d.max()));
+        }
+    }
+
+    return 0;
+}
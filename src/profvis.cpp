@@ -1,3 +1,8 @@
+#include <functional>
+#include <cerrno>
+#include <cctype>
+#include <cstdlib>
+
 #include <opts/opts.h>
 
 #include <fmt/format.h>
@@ -13,28 +18,45 @@
 #include <nanogui/colorpicker.h>
 #include <nanogui/vscrollpanel.h>
 #include <nanogui/slider.h>
+#include <nanogui/checkbox.h>
+#include <nanogui/combobox.h>
+#include <nanogui/graph.h>
 namespace ng = nanogui;
 
 #include <profvis/profile-canvas.h>
+#include <profvis/export.h>
+#include <profvis/benchmark.h>
+#include <profvis/name-list.h>
+#include <profvis/context-tree.h>
+#include <profvis/sketch.h>
+#include <profvis/collectives.h>
 namespace pv = profvis;
 
 class ProfVis: public ng::Screen
 {
     public:
-        using ColorButtons = std::unordered_map<std::string, std::tuple<ng::Button*, ng::ColorPicker*>>;
-
                             ProfVis(const pv::Profile& profile, std::string suffix = ""):
                                 ng::Screen(ng::Vector2i(1200, 800), "Profile visualizer" + suffix),
-                                profile_(new pv::ProfileCanvas(profile, this))
+                                profile_(new pv::ProfileCanvas(profile, this)),
+                                totals_(pv::total_times(profile)),
+                                sketches_(pv::duration_sketches(profile)),
+                                contexts_(pv::build_context_tree(profile)),
+                                expanded_(contexts_.nodes.size(), false)
         {
             setup_controls();
             performLayout(mNVGContext);
         }
 
         void                setup_controls();
-        void                update_button_colors();
+        void                set_filter(const std::string& expression)           { profile_->set_filter(expression); filter_box_->setValue(expression); }
+        void                show_selection(const pv::Region& region);
+        void                show_longest(ng::Widget* list);
+        void                show_contexts(ng::Widget* table);
+        void                show_offenders(ng::Widget* list);
+        void                step(int direction);
 
         virtual bool        resizeEvent(const ng::Vector2i& sz) override        { profile_->setSize(sz); return true; }
+        virtual void        drawContents() override                             { profile_->begin_frame(); profile_->update_cache(mNVGContext, mPixelRatio); }
         virtual bool        keyboardEvent(int key, int scancode, int action, int modifiers) override
         {
             if (ng::Screen::keyboardEvent(key, scancode, action, modifiers))
@@ -59,15 +81,27 @@ class ProfVis: public ng::Screen
         }
 
     private:
-        pv::ProfileCanvas*  profile_;
-        ColorButtons        color_buttons_;
+        pv::ProfileCanvas*          profile_;
+        std::vector<pv::Profile::Time>  totals_;        // per name, to sort the lists
+        std::vector<pv::DurationSketch> sketches_;      // per name
+        pv::ContextTree             contexts_;
+        std::vector<bool>           expanded_;          // per node of contexts_
+        std::vector<ng::ref<ng::Widget>>    retired_rows_;
+        pv::Collectives             collectives_;       // computed on demand
+        ng::Window*                 selection_window_ = nullptr;
+        ng::TextBox*                filter_box_       = nullptr;
+
+        // occurrences of the name being looked up
+        size_t                      find_name_      = pv::NameList::none;
+        size_t                      find_position_  = pv::NameList::none;
+        int                         top_n_          = 10;
 };
 
 void
 ProfVis::setup_controls()
 {
     auto event_window = new ng::Window(this, "Event");
-    event_window->setPosition({ 870, 600 });
+    event_window->setPosition({ 870, 540 });
     event_window->setFixedWidth(300);
     auto event_layout = new ng::GridLayout;
     event_window->setLayout(event_layout);
@@ -84,23 +118,34 @@ ProfVis::setup_controls()
     auto begin_box = add_event_field("Begin");
     auto end_box   = add_event_field("End");
     auto rank_box  = add_event_field("Rank");
-    profile_->set_callback([this,name_box,begin_box,end_box,rank_box](const pv::Profile::Event& e, int rk)
+    auto time_box  = add_event_field("Time");
+    auto total_box = add_event_field("Total");
+    time_box->setTooltip("inclusive / exclusive, in ms");
+    total_box->setTooltip("inclusive / exclusive time of the name on the rank, in ms");
+    profile_->set_callback([this,name_box,begin_box,end_box,rank_box,time_box,total_box](const pv::Profile::Event& e, int rk)
     {
         if (rk != -1)
         {
+            auto& times = profile_->profile().times(rk, e.id);
             name_box->setValue(profile_->profile().name(e));
             begin_box->setValue(time_to_string(e.begin));
             end_box->setValue(time_to_string(e.end));
             rank_box->setValue(std::to_string(rk));
+            time_box->setValue(fmt::format("{:.3f} / {:.3f}", (e.end - e.begin) / 1000., e.exclusive / 1000.));
+            total_box->setValue(fmt::format("{:.3f} / {:.3f}", times.inclusive / 1000., times.exclusive / 1000.));
         } else
         {
             name_box->setValue("");
             begin_box->setValue("");
             end_box->setValue("");
             rank_box->setValue("");
+            time_box->setValue("");
+            total_box->setValue("");
         }
     });
 
+    profile_->set_selection_callback([this](const pv::Region& region) { show_selection(region); });
+
     auto window = new ng::Window(this, "Controls");
     window->setPosition({ 15, 15 });
     window->setLayout(new ng::GroupLayout);
@@ -112,11 +157,11 @@ ProfVis::setup_controls()
     auto layout = new ng::PopupButton(window, "Layout");
     auto layout_popup = layout->popup();
     layout_popup->setLayout(new ng::GridLayout(ng::Orientation::Horizontal, 2, ng::Alignment::Fill, 10, 5));
-    auto setup_filter = [layout_popup](std::string name, size_t* variable, size_t max)
+    auto setup_filter = [this,layout_popup](std::string name, size_t* variable, size_t max)
     {
         new ng::Label(layout_popup, name);
         auto filter = new ng::IntBox<int>(layout_popup, *variable);
-        filter->setCallback([variable](int x) { *variable = x; });
+        filter->setCallback([this,variable](int x) { *variable = x; profile_->damage(); });
         filter->setEditable(true);
         filter->setSpinnable(true);
         filter->setMinValue(0);
@@ -132,51 +177,247 @@ ProfVis::setup_controls()
     setup_filter("inset",  &profile_->inset,       25);
     setup_filter("gap",    &profile_->rank_gap,    100);
 
+    auto heatmap = new ng::PopupButton(window, "Heatmap");
+    auto heatmap_popup = heatmap->popup();
+    heatmap_popup->setLayout(new ng::GridLayout(ng::Orientation::Horizontal, 2, ng::Alignment::Fill, 10, 5));
+    new ng::Label(heatmap_popup, "show");
+    auto heatmap_show = new ng::CheckBox(heatmap_popup, "");
+    heatmap_show->setCallback([this](bool x) { profile_->heatmap = x; profile_->damage(); });
+    new ng::Label(heatmap_popup, "depth");
+    auto heatmap_depth = new ng::IntBox<int>(heatmap_popup, profile_->heatmap_depth);
+    heatmap_depth->setCallback([this](int x) { profile_->heatmap_depth = x; profile_->damage(); });
+    heatmap_depth->setEditable(true);
+    heatmap_depth->setSpinnable(true);
+    heatmap_depth->setMinValue(0);
+    new ng::Label(heatmap_popup, "name");
+    auto heatmap_name = new ng::TextBox(heatmap_popup, "");
+    heatmap_name->setEditable(true);
+    heatmap_name->setPlaceholder("dominant");
+    heatmap_name->setCallback([this](const std::string& name)
+    {
+        if (name.empty())
+            profile_->heatmap_name = pv::Heatmap::dominant;
+        else if (profile_->profile().ids.count(name))
+            profile_->heatmap_name = profile_->profile().id(name);
+        else
+            return false;
+        profile_->damage();
+        return true;
+    });
+
+    auto sort = new ng::PopupButton(window, "Sort ranks");
+    auto sort_popup = sort->popup();
+    sort_popup->setLayout(new ng::GridLayout(ng::Orientation::Horizontal, 2, ng::Alignment::Fill, 10, 5));
+    new ng::Label(sort_popup, "by");
+    auto sort_metric = new ng::ComboBox(sort_popup, { "rank", "time in name", "time in MPI_*", "last end", "event count" });
+    new ng::Label(sort_popup, "name");
+    auto sort_name = new ng::TextBox(sort_popup, "");
+    sort_name->setEditable(true);
+    new ng::Label(sort_popup, "descending");
+    auto sort_descending = new ng::CheckBox(sort_popup, "");
+    sort_descending->setChecked(true);
+    auto sort_ranks = [this,sort_metric,sort_descending](const std::string& name)
+    {
+        auto&   profile = profile_->profile();
+        auto    metric  = static_cast<pv::RankMetric>(sort_metric->selectedIndex());
+        if (metric == pv::RankMetric::NameTime && !profile.ids.count(name))
+            return false;
+        size_t  id      = metric == pv::RankMetric::NameTime ? profile.id(name) : 0;
+        profile_->sort_ranks(metric, id, metric != pv::RankMetric::Number && sort_descending->checked());
+        return true;
+    };
+    sort_metric->setCallback([sort_ranks,sort_name](int) { sort_ranks(sort_name->value()); });
+    sort_name->setCallback(sort_ranks);
+    sort_descending->setCallback([sort_ranks,sort_name](bool) { sort_ranks(sort_name->value()); });
+
+    auto find = new ng::PopupButton(window, "Find");
+    auto find_popup = find->popup();
+    find_popup->setLayout(new ng::GroupLayout);
+    auto find_name = new ng::TextBox(find_popup, "");
+    find_name->setEditable(true);
+    find_name->setPlaceholder("name");
+    auto find_count = new ng::Label(find_popup, "");
+    auto find_durations = new ng::Label(find_popup, "");
+    auto find_histogram = new ng::Graph(find_popup, "");
+    find_histogram->setFixedHeight(60);
+    find_histogram->setTooltip("durations, on a logarithmic scale");
+    auto find_buttons = new ng::Widget(find_popup);
+    find_buttons->setLayout(new ng::BoxLayout(ng::Orientation::Horizontal, ng::Alignment::Middle, 0, 6));
+    auto previous = new ng::Button(find_buttons, "Previous");
+    previous->setCallback([this]() { step(-1); });
+    auto next = new ng::Button(find_buttons, "Next");
+    next->setCallback([this]() { step(1); });
+    new ng::Label(find_buttons, "longest");
+    auto top_n = new ng::IntBox<int>(find_buttons, top_n_);
+    top_n->setEditable(true);
+    top_n->setSpinnable(true);
+    top_n->setMinValue(0);
+    auto longest = new ng::Widget(find_popup);
+    longest->setLayout(new ng::BoxLayout(ng::Orientation::Vertical, ng::Alignment::Fill, 0, 2));
+    top_n->setCallback([this,longest](int n) { top_n_ = n; show_longest(longest); });
+    find_name->setCallback([this,find_count,find_durations,find_histogram,longest](const std::string& name)
+    {
+        auto& profile = profile_->profile();
+        if (!profile.ids.count(name))
+            return false;
+
+        find_name_     = profile.id(name);
+        find_position_ = pv::NameList::none;
+        find_count->setCaption(fmt::format("{} occurrences", profile_->occurrences().count(find_name_)));
+
+        auto& sketch = sketches_[find_name_];
+        find_durations->setCaption(fmt::format("p50 {:.3f}, p90 {:.3f}, p99 {:.3f}, max {:.3f} ms",
+                                               sketch.quantile(.5) / 1000., sketch.quantile(.9) / 1000.,
+                                               sketch.quantile(.99) / 1000., sketch.max() / 1000.));
+        auto    counts  = sketch.histogram(40);
+        float   highest = std::max(1.f, *std::max_element(counts.begin(), counts.end()));
+        ng::VectorXf values(counts.size());
+        for (size_t i = 0; i < counts.size(); ++i)
+            values[i] = counts[i] / highest;
+        find_histogram->setValues(values);
+        find_histogram->setHeader(fmt::format("{:.3f} ms", sketch.min() / 1000.));
+        find_histogram->setFooter(fmt::format("{:.3f} ms", sketch.max() / 1000.));
+        show_longest(longest);
+        return true;
+    });
+
+    auto contexts = new ng::PopupButton(window, "Contexts");
+    auto contexts_popup = contexts->popup();
+    contexts_popup->setLayout(new ng::GroupLayout);
+    new ng::Label(contexts_popup, "calling contexts, times in ms, summed over the ranks");
+    auto contexts_scroll = new ng::VScrollPanel(contexts_popup);
+    contexts_scroll->setFixedHeight(400);
+    auto contexts_table = new ng::Widget(contexts_scroll);
+    auto save_folded = new ng::Button(contexts_popup, "Save folded stacks");
+    save_folded->setCallback([this]
+    {
+        auto filename = ng::file_dialog({ {"folded", "Folded stacks"}, {"txt", "Text file"} }, true);
+        if (filename.empty())
+            return;
+        std::ofstream out(filename);
+        pv::write_folded(profile_->profile(), contexts_, out);
+    });
+    expanded_[pv::ContextTree::root] = true;
+    show_contexts(contexts_table);
+
+    auto imbalance = new ng::PopupButton(window, "Imbalance");
+    auto imbalance_popup = imbalance->popup();
+    imbalance_popup->setLayout(new ng::GroupLayout);
+    auto analyze = new ng::Button(imbalance_popup, "Analyze collectives");
+    auto imbalance_summary = new ng::Label(imbalance_popup, "collectives are matched by their order on each rank");
+    auto critical_path = new ng::CheckBox(imbalance_popup, "Critical path");
+    critical_path->setEnabled(false);
+    critical_path->setCallback([this](bool x) { profile_->set_path(x ? collectives_.critical_path : std::vector<pv::Collectives::Segment>()); });
+    new ng::Label(imbalance_popup, "Worst offenders", "sans-bold");
+    auto offenders = new ng::Widget(imbalance_popup);
+    offenders->setLayout(new ng::BoxLayout(ng::Orientation::Vertical, ng::Alignment::Fill, 0, 2));
+    analyze->setCallback([this,imbalance_summary,critical_path,offenders]()
+    {
+        collectives_ = pv::analyze_collectives(profile_->profile());
+
+        pv::Profile::Time waited = 0;
+        for (auto w : collectives_.waited)
+            waited += w;
+        imbalance_summary->setCaption(fmt::format("{} collective calls, {:.3f} ms spent waiting",
+                                                  collectives_.instances.size(), waited / 1000.));
+        critical_path->setEnabled(!collectives_.critical_path.empty());
+        if (critical_path->checked())
+            profile_->set_path(collectives_.critical_path);
+        show_offenders(offenders);
+    });
+
     new ng::Label(window, "Time (min duration shown)");
     auto time_filter = new ng::IntBox<pv::Profile::Time>(window, profile_->time_filter);
-    time_filter->setCallback([this](pv::Profile::Time t) { profile_->time_filter = t; });
+    time_filter->setCallback([this](pv::Profile::Time t) { profile_->time_filter = t; profile_->damage(); });
     time_filter->setEditable(true);
 
+    new ng::Label(window, "Filter");
+    auto filter = new ng::TextBox(window, "");
+    filter->setEditable(true);
+    filter->setAlignment(ng::TextBox::Alignment::Left);
+    filter->setPlaceholder("name =~ \"^MPI_\" && duration > 5ms");
+    filter->setTooltip("terms: name =~ \"regex\", duration|rank|depth < <= > >= == != x, rank|depth in a-b,c; combined with !, &&, ||");
+    filter_box_ = filter;
+    filter->setCallback([this,filter](const std::string& expression)
+    {
+        try
+        {
+            profile_->set_filter(expression);
+        } catch (const std::runtime_error& e)
+        {
+            filter->setTooltip(e.what());
+            return false;
+        }
+        return true;
+    });
+
+    auto auto_filter = new ng::CheckBox(window, "Automatic");
+    auto_filter->setChecked(profile_->auto_filter);
+    auto_filter->setCallback([this](bool x) { profile_->auto_filter = x; profile_->damage(); });
+
+    auto level_of_detail = new ng::CheckBox(window, "Level of detail");
+    level_of_detail->setChecked(profile_->level_of_detail);
+    level_of_detail->setCallback([this](bool x) { profile_->level_of_detail = x; profile_->damage(); });
+
+    auto labels = new ng::CheckBox(window, "Labels");
+    labels->setChecked(profile_->labels);
+    labels->setCallback([this](bool x) { profile_->labels = x; profile_->damage(); });
+
+    auto overview = new ng::CheckBox(window, "Overview");
+    overview->setChecked(profile_->overview);
+    overview->setCallback([this](bool x) { profile_->overview = x; });
+
+    auto messages = new ng::CheckBox(window, "Messages");
+    messages->setChecked(profile_->messages);
+    messages->setTooltip(fmt::format("{} matched point-to-point messages, {} unmatched calls",
+                                     profile_->matched_messages().levels[0].flows.size(),
+                                     profile_->matched_messages().unmatched));
+    messages->setCallback([this](bool x) { profile_->messages = x; });
+
+    auto concurrency = new ng::CheckBox(window, "Concurrency");
+    concurrency->setChecked(profile_->concurrency);
+    concurrency->setTooltip("ranks inside each name over time; a rank counts towards its innermost event");
+    concurrency->setCallback([this](bool x) { profile_->concurrency = x; });
+
+    auto statistics = new ng::CheckBox(window, "Statistics");
+    statistics->setChecked(profile_->statistics);
+    statistics->setCallback([this](bool x) { profile_->statistics = x; });
+
     new ng::Label(window, "Colors");
 
     auto select_colors = new ng::PopupButton(window, "Select");
     auto color_popup = select_colors->popup();
     color_popup->setLayout(new ng::GroupLayout);
 
-    // fill colors both in Select and Events popups
-    for (size_t i = 0; i < profile_->colors().size(); ++i)
+    // names are listed in the Events and Select popups, longest total time first
+    auto events_search = new pv::SearchBox(events_popup);
+    auto events_list   = new pv::NameList(events_popup, profile_, totals_);
+    events_search->set_search_callback([events_list](const std::string& s) { events_list->set_search(s); });
+    events_list->set_callback([this](size_t id) { profile_->toggle(profile_->profile().name(id)); });
+
+    auto color_search = new pv::SearchBox(color_popup);
+    auto color_list   = new pv::NameList(color_popup, profile_, totals_);
+    color_search->set_search_callback([color_list](const std::string& s) { color_list->set_search(s); });
+    auto picker       = new ng::ColorPicker(color_popup);
+    picker->setCaption("select a name");
+    color_list->set_callback([this,picker](size_t id)
     {
-        auto& c = profile_->colors()[i];
-        auto name = profile_->profile().name(i);
-
-        auto button = new ng::Button(events_popup, name);
-        button->setFlags(ng::Button::ToggleButton);
-        button->setBackgroundColor(c);
-        button->setTextColor(c.contrastingColor());
-        button->setChangeCallback([name, this](bool state) { profile_->toggle(name); });
-
-        auto cb = new ng::ColorPicker(color_popup, c);
-        cb->setCaption(name);
-        cb->setTextColor(c.contrastingColor());
-        cb->setFinalCallback([this,button,cb,name](const ng::Color& c)
-        {
-            button->setBackgroundColor(c);
-            button->setTextColor(c.contrastingColor());
-            cb->setTextColor(c.contrastingColor());
-
-            profile_->set_color(name, c);
-        });
-
-        color_buttons_[name] = { button, cb };
-    }
-
-    auto randomize_colors = new ng::Button(window, "Randomize");
-    randomize_colors->setCallback([this]()
+        auto& c = profile_->colors()[id];
+        picker->setColor(c);
+        picker->setCaption(profile_->profile().name(id));
+        picker->setTextColor(c.contrastingColor());
+    });
+    picker->setFinalCallback([this,picker,color_list](const ng::Color& c)
     {
-        profile_->randomize_colors();
-        update_button_colors();
+        if (color_list->selected() == pv::NameList::none)
+            return;
+        picker->setTextColor(c.contrastingColor());
+        profile_->set_color(profile_->profile().name(color_list->selected()), c);
     });
 
+    auto randomize_colors = new ng::Button(window, "Randomize");
+    randomize_colors->setCallback([this]() { profile_->randomize_colors(); });
+
     auto save_colors = new ng::Button(window, "Save");
     save_colors->setCallback([&]
     {
@@ -205,31 +446,217 @@ ProfVis::setup_controls()
             ins >> name >> r >> g >> b;
             profile_->set_color(name, ng::Color { r, g, b, 1.f });
         }
-
-        update_button_colors();
     });
 }
 
 void
 ProfVis::
-update_button_colors()
+show_selection(const pv::Region& region)
+{
+    if (selection_window_)
+        selection_window_->dispose();
+
+    selection_window_ = new ng::Window(this, "Selection");
+    selection_window_->setPosition({ 250, 15 });
+    selection_window_->setLayout(new ng::GroupLayout);
+
+    // with the ranks reordered, the selected ones needn't be consecutive
+    auto& ranks = region.ranks;
+    bool  consecutive = !ranks.empty() && ranks.back() >= ranks.front() && ranks.back() - ranks.front() + 1 == ranks.size() &&
+                        std::is_sorted(ranks.begin(), ranks.end());
+    new ng::Label(selection_window_, fmt::format("{} - {}, {}, times in ms",
+                                                time_to_string(region.begin), time_to_string(region.end),
+                                                consecutive ? fmt::format("ranks {}-{}", ranks.front(), ranks.back())
+                                                            : fmt::format("{} ranks", ranks.size())));
+
+    auto table = new ng::Widget(selection_window_);
+    auto grid  = new ng::GridLayout(ng::Orientation::Horizontal, 7, ng::Alignment::Maximum, 0, 2);
+    grid->setColAlignment({ ng::Alignment::Minimum, ng::Alignment::Maximum });
+    table->setLayout(grid);
+
+    for (auto header : { "name", "inclusive", "exclusive", "count", "min", "mean", "max" })
+        new ng::Label(table, header, "sans-bold");
+
+    // milliseconds
+    auto ms = [](double t) { return fmt::format("{:.3f}", t / 1000); };
+
+    const size_t rows = 25;
+    for (size_t i = 0; i < std::min(rows, region.names.size()); ++i)
+    {
+        auto& s = region.names[i].second;
+        new ng::Label(table, profile_->profile().name(region.names[i].first));
+        new ng::Label(table, ms(s.inclusive));
+        new ng::Label(table, ms(s.exclusive));
+        new ng::Label(table, std::to_string(s.count));
+        new ng::Label(table, s.count ? ms(s.min) : "-");
+        new ng::Label(table, s.count ? ms(s.mean()) : "-");
+        new ng::Label(table, s.count ? ms(s.max) : "-");
+    }
+    if (region.names.size() > rows)
+        new ng::Label(selection_window_, fmt::format("{} more names", region.names.size() - rows));
+
+    auto close = new ng::Button(selection_window_, "Close");
+    close->setCallback([this]() { selection_window_->dispose(); selection_window_ = nullptr; });
+
+    performLayout(mNVGContext);
+}
+
+
+void
+ProfVis::
+show_longest(ng::Widget* list)
+{
+    while (list->childCount() > 0)
+        list->removeChild(list->childCount() - 1);
+
+    if (find_name_ != pv::NameList::none)
+    {
+        auto&  occurrences = profile_->occurrences();
+        size_t n           = std::min<size_t>(std::max(top_n_, 0), occurrences.count(find_name_));
+        for (size_t k = 0; k < n; ++k)
+        {
+            size_t  position = occurrences.by_duration[occurrences.first(find_name_) + k];
+            auto&   o        = occurrences.by_begin[position];
+            auto    button   = new ng::Button(list, fmt::format("{:.3f} ms on rank {} at {}",
+                                                                o.duration / 1000., o.rank, time_to_string(o.begin)));
+            button->setCallback([this,position]()
+            {
+                find_position_ = position;
+                profile_->focus(profile_->occurrences().by_begin[position]);
+            });
+        }
+    }
+
+    performLayout(mNVGContext);
+}
+
+void
+ProfVis::
+show_contexts(ng::Widget* table)
 {
-    // update button colors
-    for (auto& x : color_buttons_)
+    // the rows are rebuilt from the callbacks of their own buttons, so they are released one rebuild later
+    retired_rows_.assign(table->children().begin(), table->children().end());
+    while (table->childCount() > 0)
+        table->removeChild(table->childCount() - 1);
+
+    auto grid = new ng::GridLayout(ng::Orientation::Horizontal, 5, ng::Alignment::Maximum, 0, 2);
+    grid->setColAlignment({ ng::Alignment::Middle, ng::Alignment::Minimum, ng::Alignment::Maximum });
+    table->setLayout(grid);
+
+    for (auto header : { "", "name", "inclusive", "exclusive", "count" })
+        new ng::Label(table, header, "sans-bold");
+
+    auto ms = [](pv::Profile::Time t) { return fmt::format("{:.3f}", t / 1000.); };
+
+    // expanded nodes show their children, the longest ones first
+    const size_t max_children = 50;
+    std::function<void(size_t)> add_rows = [&](size_t id)
     {
-        auto                name = x.first;
-        ng::Button*         b    = std::get<0>(x.second);
-        ng::ColorPicker*    cb   = std::get<1>(x.second);
+        auto& n = contexts_.nodes[id];
+        if (id != pv::ContextTree::root)
+        {
+            if (n.children.empty())
+                new ng::Label(table, "");
+            else
+            {
+                auto toggle = new ng::Button(table, expanded_[id] ? "-" : "+");
+                toggle->setFixedWidth(20);
+                toggle->setCallback([this,id,table]() { expanded_[id] = !expanded_[id]; show_contexts(table); });
+            }
+            auto name = new ng::Label(table, std::string(2*(n.depth - 1), ' ') + profile_->profile().name(n.name));
+            name->setTooltip(contexts_.path(profile_->profile(), id, ':'));
+            new ng::Label(table, ms(n.totals.inclusive));
+            new ng::Label(table, ms(n.totals.exclusive));
+            new ng::Label(table, std::to_string(n.totals.count));
+        }
+
+        if (!expanded_[id])
+            return;
+
+        size_t shown = std::min(max_children, n.children.size());
+        for (size_t i = 0; i < shown; ++i)
+            add_rows(n.children[i]);
+        if (n.children.size() > shown)
         {
-            auto c = profile_->colors()[profile_->profile().id(name)];
-            b->setBackgroundColor(c);
-            b->setTextColor(c.contrastingColor());
-            cb->setBackgroundColor(c);
-            cb->setTextColor(c.contrastingColor());
+            new ng::Label(table, "");
+            new ng::Label(table, std::string(2*n.depth, ' ') + fmt::format("{} more", n.children.size() - shown));
+            for (int i = 0; i < 3; ++i)
+                new ng::Label(table, "");
         }
+    };
+    add_rows(pv::ContextTree::root);
+
+    performLayout(mNVGContext);
+}
+
+void
+ProfVis::
+show_offenders(ng::Widget* list)
+{
+    while (list->childCount() > 0)
+        list->removeChild(list->childCount() - 1);
+
+    for (size_t rk : collectives_.offenders(std::max(top_n_, 0)))
+    {
+        if (collectives_.caused[rk] == 0)
+            break;
+
+        auto button = new ng::Button(list, fmt::format("rank {}: kept the others waiting {:.3f} ms, waited {:.3f} ms",
+                                                       rk, collectives_.caused[rk] / 1000., collectives_.waited[rk] / 1000.));
+        button->setTooltip("show its latest arrival that cost the most");
+        button->setCallback([this,rk]()
+        {
+            auto& instance = collectives_.instances[collectives_.worst[rk]];
+            auto& a        = collectives_.ranks[rk][instance.late_index];
+            profile_->focus(pv::Occurrences::Occurrence { a.begin, a.end - a.begin, static_cast<std::uint32_t>(rk),
+                                                         static_cast<std::uint32_t>(a.depth), static_cast<std::uint32_t>(a.index) });
+        });
     }
+
+    performLayout(mNVGContext);
 }
 
+void
+ProfVis::
+step(int direction)
+{
+    if (find_name_ == pv::NameList::none)
+        return;
+
+    auto&  occurrences = profile_->occurrences();
+    size_t first       = occurrences.first(find_name_);
+    size_t last        = occurrences.last(find_name_);
+
+    // without a current occurrence, start from the middle of the view
+    size_t position;
+    if (find_position_ < first || find_position_ >= last)
+    {
+        position = occurrences.first_after(find_name_, profile_->center_time());
+        if (direction < 0)
+            position = position > first ? position - 1 : last;
+    } else if (direction > 0)
+        position = find_position_ + 1;
+    else
+        position = find_position_ > first ? find_position_ - 1 : last;
+
+    if (position >= last)
+        return;
+
+    find_position_ = position;
+    profile_->focus(occurrences.by_begin[position]);
+}
+
+// non-negative integer given to an option, or std::runtime_error
+unsigned long
+parse_number(const std::string& s, const char* option)
+{
+    char* end;
+    errno = 0;
+    unsigned long x = std::strtoul(s.c_str(), &end, 10);
+    if (s.empty() || !std::isdigit(static_cast<unsigned char>(s[0])) || *end != '\0' || errno == ERANGE)
+        throw std::runtime_error(fmt::format("Invalid number for --{}: '{}'", option, s));
+    return x;
+}
 
 int main(int argc, char *argv[])
 {
@@ -240,11 +667,27 @@ int main(int argc, char *argv[])
     bool caliper;
     bool mpi_functions;
     pv::Profile::Time start_time = std::numeric_limits<pv::Profile::Time>::min();
+    std::string export_fn;
+    std::string window      = ":";
+    std::string ranks;
+    int         image_width = 1600;
+    int         image_height = 0;
+    size_t      repeats     = 0;
+    std::string filter;
+    std::string folded_fn;
     ops
         >> Option('h', "help",          help,           "show help")
         >> Option('c', "caliper",       caliper,        "parse caliper format")
         >> Option('m', "mpi-functions", mpi_functions,  "parse mpi functions")
         >> Option('s', "start",         start_time,     "time to start the profile")
+        >> Option('e', "export",        export_fn,      "render into FILE.png or FILE.svg without opening a window")
+        >> Option('w', "window",        window,         "time interval to export, t0:t1, relative to the start")
+        >> Option('r', "ranks",         ranks,          "ranks to export, a-b")
+        >> Option(     "image-width",   image_width,    "width of the exported image")
+        >> Option(     "image-height",  image_height,   "height of the exported image, squeezing the ranks to fit (default: their own height, at most 8192)")
+        >> Option('f', "filter",        filter,         "show only the events that match the expression")
+        >> Option('b', "benchmark",     repeats,        "collect views at increasing zoom this many times, print the statistics, and exit")
+        >> Option(     "folded",        folded_fn,      "write the calling contexts as folded stacks (for flamegraph.pl) and exit")
     ;
 
     std::string     infn;
@@ -258,8 +701,6 @@ int main(int argc, char *argv[])
 
     try
     {
-        nanogui::init();
-
         pv::Profile profile;
         if (!caliper)
             profile = pv::read_profile(infn);
@@ -269,12 +710,69 @@ int main(int argc, char *argv[])
         if (start_time != std::numeric_limits<pv::Profile::Time>::min())
             profile.min_time_ = start_time;
 
+        if (!folded_fn.empty())
+        {
+            std::ofstream out(folded_fn);
+            pv::write_folded(profile, pv::build_context_tree(profile), out);
+            return 0;
+        }
+
+        if (repeats > 0)
+        {
+            ng::ref<pv::ProfileCanvas> canvas = new pv::ProfileCanvas(profile, nullptr);
+            canvas->labels = false;
+            canvas->set_filter(filter);
+            pv::benchmark(*canvas, repeats);
+            return 0;
+        }
+
+        if (!export_fn.empty())
+        {
+            pv::ExportWindow w;
+            w.begin      = profile.min_time();
+            w.end        = profile.max_time();
+            w.first_rank = 0;
+            w.last_rank  = profile.events.size();
+            w.width      = image_width;
+            w.height     = image_height;
+
+            auto colon = window.find(':');
+            if (colon == std::string::npos)
+                throw std::runtime_error("Window must be given as t0:t1");
+            if (colon > 0)
+                w.begin = profile.min_time() + parse_number(window.substr(0, colon), "window");
+            if (colon + 1 < window.size())
+                w.end   = profile.min_time() + parse_number(window.substr(colon + 1), "window");
+            if (w.begin >= w.end)
+                throw std::runtime_error(fmt::format("Window {} is empty or reversed", window));
+
+            if (!ranks.empty())
+            {
+                auto dash = ranks.find('-');
+                w.first_rank = parse_number(ranks.substr(0, dash), "ranks");
+                w.last_rank  = dash == std::string::npos ? w.first_rank + 1 : parse_number(ranks.substr(dash + 1), "ranks") + 1;
+                if (w.first_rank >= w.last_rank)
+                    throw std::runtime_error(fmt::format("Ranks {} are reversed", ranks));
+            }
+
+            // the canvas only lays out the rectangles, so it needs no window
+            ng::ref<pv::ProfileCanvas> canvas = new pv::ProfileCanvas(profile, nullptr);
+            canvas->labels      = false;
+            canvas->auto_filter = true;     // merge sub-pixel events instead of dropping them
+            canvas->set_filter(filter);
+            pv::export_image(*canvas, w, export_fn);
+            return 0;
+        }
+
+        nanogui::init();
+
         ProfVis*    app     = new ProfVis(profile, " - " + infn);
+        app->set_filter(filter);
 
         app->drawAll();
         app->setVisible(true);
 
-        nanogui::mainloop();
+        nanogui::mainloop(-1);          // redraw only in response to events
 
         delete app;
 
@@ -0,0 +1,71 @@
+#include <profvis/rank-order.h>
+#include <profvis/parallel.h>
+
+#include <algorithm>
+
+namespace
+{
+
+using Events = profvis::Profile::Events;
+using Time   = profvis::Profile::Time;
+
+// time in the events that pass match, not counting the ones nested in a match again
+template<class Match>
+Time
+time_in(const Events& events, const Match& match)
+{
+    Time t = 0;
+    for (auto& e : events)
+        t += match(e.id) ? e.end - e.begin : time_in(e.events, match);
+    return t;
+}
+
+size_t
+count(const Events& events)
+{
+    size_t n = events.size();
+    for (auto& e : events)
+        n += count(e.events);
+    return n;
+}
+
+}
+
+std::vector<double>
+profvis::
+rank_metric(const Profile& profile, RankMetric metric, size_t name)
+{
+    std::vector<bool> mpi;
+    if (metric == RankMetric::MPITime)
+        for (auto& n : profile.names)
+            mpi.push_back(n.compare(0, 4, "MPI_") == 0);
+
+    std::vector<double> values(profile.events.size(), 0);
+    parallel_for(profile.events.size(), [&](size_t rk)
+    {
+        auto& events = profile.events[rk];
+        switch (metric)
+        {
+            case RankMetric::Number:    values[rk] = rk;                                                            break;
+            case RankMetric::NameTime:  values[rk] = time_in(events, [name](size_t id) { return id == name; });    break;
+            case RankMetric::MPITime:   values[rk] = time_in(events, [&mpi](size_t id) { return mpi[id]; });       break;
+            case RankMetric::LastEnd:   values[rk] = events.empty() ? 0 : events.back().end;                        break;
+            case RankMetric::Count:     values[rk] = count(events);                                                 break;
+        }
+    });
+
+    return values;
+}
+
+std::vector<size_t>
+profvis::
+rank_order(const std::vector<double>& metric, bool descending)
+{
+    std::vector<size_t> order(metric.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&metric,descending](size_t a, size_t b)
+                     { return descending ? metric[a] > metric[b] : metric[a] < metric[b]; });
+    return order;
+}
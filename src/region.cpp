@@ -0,0 +1,217 @@
+#include <profvis/region.h>
+#include <profvis/parallel.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace
+{
+
+using Time      = profvis::Profile::Time;
+using Events    = profvis::Profile::Events;
+using Rank      = profvis::RegionIndex::Rank;
+using Stats     = std::unordered_map<size_t, profvis::NameStats>;
+
+struct Occurrence
+{
+    std::uint32_t   id;
+    Time            begin, duration, exclusive;
+    bool            outermost;
+};
+
+// open holds the names of the enclosing events, like the open counters of compute_times()
+void
+gather(const Events& events, std::vector<Occurrence>& occurrences, std::vector<std::uint32_t>& open)
+{
+    for (auto& e : events)
+    {
+        auto id        = static_cast<std::uint32_t>(e.id);
+        bool outermost = std::find(open.begin(), open.end(), id) == open.end();
+        occurrences.push_back(Occurrence { id, e.begin, e.end - e.begin, e.exclusive, outermost });
+
+        open.push_back(id);
+        gather(e.events, occurrences, open);
+        open.pop_back();
+    }
+}
+
+// whether one of the enclosing events, chain[0..depth), has the same name
+bool
+nested(const std::vector<const profvis::Profile::Event*>& chain, size_t depth)
+{
+    for (size_t d = 0; d < depth; ++d)
+        if (chain[d]->id == chain[depth]->id)
+            return true;
+    return false;
+}
+
+void
+extremes(const Rank& r, size_t lo, size_t hi, profvis::NameStats& s)
+{
+    const size_t block = profvis::RegionIndex::block;
+    auto update = [&s](Time mn, Time mx) { s.min = std::min(s.min, mn); s.max = std::max(s.max, mx); };
+
+    for (; lo < hi && lo % block; ++lo)
+        update(r.durations[lo], r.durations[lo]);
+    for (; lo + block <= hi; lo += block)
+        update(r.block_min[lo / block], r.block_max[lo / block]);
+    for (; lo < hi; ++lo)
+        update(r.durations[lo], r.durations[lo]);
+}
+
+void
+rank_stats(const Rank& r, const profvis::EventIndex& events, size_t rk, Time begin, Time end, Stats& stats)
+{
+    // whole events that begin in the region
+    for (size_t i = 0; i < r.ids.size(); ++i)
+    {
+        auto first = r.begins.begin() + r.offsets[i];
+        auto last  = r.begins.begin() + r.offsets[i + 1];
+        size_t lo = std::lower_bound(first, last, begin) - r.begins.begin();
+        size_t hi = std::lower_bound(first, last, end)   - r.begins.begin();
+        if (lo == hi)
+            continue;
+
+        auto& s = stats[r.ids[i]];
+        s.count     += hi - lo;
+        s.total     += r.totals[hi] - r.totals[lo];
+        s.inclusive += r.inclusive[hi] - r.inclusive[lo];
+        s.exclusive += r.exclusive[hi] - r.exclusive[lo];
+        extremes(r, lo, hi, s);
+    }
+
+    // Clip the events that cross the ends of the region; there is at most one per depth, and they enclose
+    // each other. The inclusive time of one nested in its name is already covered by the enclosing one.
+    size_t depths = rk < events.ranks.size() ? events.ranks[rk].size() : 0;
+    auto   exclusive = [&](size_t depth, Time b, Time e) { return e - b - events.covered(rk, depth + 1, b, e); };
+    std::vector<const profvis::Profile::Event*> chain;
+
+    for (size_t d = 0; d < depths; ++d)
+    {
+        auto* e = events.find(rk, d, end);
+        if (!e)
+            break;
+        chain.push_back(e);
+        if (e->begin >= begin && e->begin < end && e->end > end)       // counted whole above
+        {
+            auto& s = stats[e->id];
+            if (!nested(chain, d))
+                s.inclusive -= e->end - end;
+            s.exclusive -= exclusive(d, end, e->end);
+        }
+    }
+
+    chain.clear();
+    for (size_t d = 0; d < depths; ++d)
+    {
+        auto* e = events.find(rk, d, begin);
+        if (!e)
+            break;
+        chain.push_back(e);
+        if (e->begin < begin && e->end > begin)                         // not counted above
+        {
+            Time  last = std::min(e->end, end);
+            auto& s    = stats[e->id];
+            if (!nested(chain, d))
+                s.inclusive += last - begin;
+            s.exclusive += exclusive(d, begin, last);
+        }
+    }
+}
+
+}
+
+constexpr size_t    profvis::RegionIndex::block;
+
+profvis::RegionIndex
+profvis::
+build_region_index(const Profile& profile)
+{
+    RegionIndex index;
+    index.ranks.resize(profile.events.size());
+
+    parallel_for(profile.events.size(), [&](size_t rk)
+    {
+        std::vector<Occurrence>     occurrences;
+        std::vector<std::uint32_t>  open;
+        gather(profile.events[rk], occurrences, open);
+        std::stable_sort(occurrences.begin(), occurrences.end(),
+                         [](const Occurrence& a, const Occurrence& b) { return a.id < b.id || (a.id == b.id && a.begin < b.begin); });
+
+        auto&  r = index.ranks[rk];
+        size_t n = occurrences.size();
+        r.begins.resize(n);
+        r.durations.resize(n);
+        r.totals.resize(n + 1, 0);
+        r.inclusive.resize(n + 1, 0);
+        r.exclusive.resize(n + 1, 0);
+        for (size_t i = 0; i < n; ++i)
+        {
+            auto& o = occurrences[i];
+            if (i == 0 || o.id != occurrences[i - 1].id)
+            {
+                r.ids.push_back(o.id);
+                r.offsets.push_back(i);
+            }
+            r.begins[i]        = o.begin;
+            r.durations[i]     = o.duration;
+            r.totals[i + 1]    = r.totals[i] + o.duration;
+            r.inclusive[i + 1] = r.inclusive[i] + (o.outermost ? o.duration : 0);
+            r.exclusive[i + 1] = r.exclusive[i] + o.exclusive;
+        }
+        r.offsets.push_back(n);
+
+        for (size_t b = 0; b < n; b += RegionIndex::block)
+        {
+            auto first = r.durations.begin() + b;
+            auto last  = r.durations.begin() + std::min(n, b + RegionIndex::block);
+            r.block_min.push_back(*std::min_element(first, last));
+            r.block_max.push_back(*std::max_element(first, last));
+        }
+    });
+
+    return index;
+}
+
+profvis::Region
+profvis::
+region_stats(const RegionIndex& regions, const EventIndex& events,
+             Profile::Time begin, Profile::Time end, std::vector<size_t> ranks)
+{
+    Region region { begin, end, std::move(ranks), {} };
+    if (region.ranks.empty() || end <= begin)
+        return region;
+
+    // ranks are split into chunks, each with its own map, merged at the end
+    size_t              n      = region.ranks.size();
+    size_t              chunks = std::min<size_t>(n, 4 * std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<Stats>  partial(chunks);
+    parallel_for(chunks, [&](size_t c)
+    {
+        for (size_t i = c * n / chunks; i < (c + 1) * n / chunks; ++i)
+        {
+            size_t rk = region.ranks[i];
+            rank_stats(regions.ranks[rk], events, rk, begin, end, partial[c]);
+        }
+    });
+
+    Stats stats;
+    for (auto& p : partial)
+        for (auto& x : p)
+        {
+            auto& s = stats[x.first];
+            s.inclusive += x.second.inclusive;
+            s.exclusive += x.second.exclusive;
+            s.count     += x.second.count;
+            s.total     += x.second.total;
+            s.min        = std::min(s.min, x.second.min);
+            s.max        = std::max(s.max, x.second.max);
+        }
+
+    region.names.assign(stats.begin(), stats.end());
+    std::sort(region.names.begin(), region.names.end(),
+              [](const std::pair<size_t, NameStats>& a, const std::pair<size_t, NameStats>& b)
+              { return a.second.inclusive > b.second.inclusive; });
+
+    return region;
+}
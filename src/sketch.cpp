@@ -0,0 +1,171 @@
+#include <profvis/sketch.h>
+#include <profvis/parallel.h>
+
+#include <algorithm>
+#include <cmath>
+
+constexpr unsigned profvis::DurationSketch::sub_bits;
+
+namespace
+{
+
+using Sketch = profvis::DurationSketch;
+
+// position of the highest set bit
+unsigned
+high_bit(Sketch::Time x)
+{
+    unsigned e = 0;
+    for (unsigned shift = 32; shift > 0; shift /= 2)
+        if (x >> shift)
+        {
+            x >>= shift;
+            e  += shift;
+        }
+    return e;
+}
+
+void
+add_durations(const profvis::Profile::Events& events, std::vector<Sketch>& sketches)
+{
+    for (auto& e : events)
+    {
+        sketches[e.id].add(e.end - e.begin);
+        add_durations(e.events, sketches);
+    }
+}
+
+}
+
+size_t
+profvis::DurationSketch::
+bucket(Time duration)
+{
+    const Time linear = Time(1) << sub_bits;
+    if (duration < linear)
+        return duration;
+
+    unsigned e   = high_bit(duration);
+    size_t   sub = (duration >> (e - sub_bits)) & (linear - 1);
+    return (e - sub_bits + 1) * linear + sub;
+}
+
+profvis::DurationSketch::Time
+profvis::DurationSketch::
+lower(size_t bucket)
+{
+    const Time linear = Time(1) << sub_bits;
+    if (bucket < linear)
+        return bucket;
+
+    unsigned e   = bucket / linear - 1 + sub_bits;
+    Time     sub = bucket % linear;
+    return (linear + sub) << (e - sub_bits);
+}
+
+profvis::DurationSketch::Time
+profvis::DurationSketch::
+upper(size_t bucket)
+{
+    const Time linear = Time(1) << sub_bits;
+    if (bucket < linear)
+        return bucket;
+
+    unsigned e = bucket / linear - 1 + sub_bits;
+    return lower(bucket) + (Time(1) << (e - sub_bits)) - 1;
+}
+
+void
+profvis::DurationSketch::
+add(Time duration)
+{
+    size_t b = bucket(duration);
+    if (b >= counts_.size())
+        counts_.resize(b + 1, 0);
+    ++counts_[b];
+
+    min_ = count_ ? std::min(min_, duration) : duration;
+    max_ = std::max(max_, duration);
+    ++count_;
+}
+
+void
+profvis::DurationSketch::
+merge(const DurationSketch& other)
+{
+    if (!other.count_)
+        return;
+
+    if (other.counts_.size() > counts_.size())
+        counts_.resize(other.counts_.size(), 0);
+    for (size_t b = 0; b < other.counts_.size(); ++b)
+        counts_[b] += other.counts_[b];
+
+    min_    = count_ ? std::min(min_, other.min_) : other.min_;
+    max_    = std::max(max_, other.max_);
+    count_ += other.count_;
+}
+
+profvis::DurationSketch::Time
+profvis::DurationSketch::
+quantile(double q) const
+{
+    if (!count_)
+        return 0;
+
+    size_t target = std::max<size_t>(1, std::ceil(q * count_));
+    size_t seen   = 0;
+    for (size_t b = 0; b < counts_.size(); ++b)
+    {
+        seen += counts_[b];
+        if (seen >= target)
+        {
+            // the middle of the bucket, within the exact extremes
+            Time t = lower(b) + (upper(b) - lower(b)) / 2;
+            return std::max(min_, std::min(max_, t));
+        }
+    }
+    return max_;
+}
+
+std::vector<float>
+profvis::DurationSketch::
+histogram(size_t bins) const
+{
+    std::vector<float> result(bins, 0);
+    if (!count_ || !bins)
+        return result;
+
+    double lo    = std::log(double(min_) + 1);
+    double range = std::log(double(max_) + 1) - lo;
+    for (size_t b = 0; b < counts_.size(); ++b)
+    {
+        if (!counts_[b])
+            continue;
+        Time   t = std::max(min_, std::min(max_, lower(b) + (upper(b) - lower(b)) / 2));
+        size_t i = range > 0 ? std::min<size_t>(bins - 1, (std::log(double(t) + 1) - lo) / range * bins) : 0;
+        result[i] += counts_[b];
+    }
+    return result;
+}
+
+std::vector<profvis::DurationSketch>
+profvis::
+duration_sketches(const Profile& profile)
+{
+    // ranks are split into chunks, each sketched separately, to bound the memory
+    size_t chunks = std::min<size_t>(profile.events.size(), 4 * std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::vector<DurationSketch>> partial(chunks);
+    parallel_for(chunks, [&](size_t c)
+    {
+        partial[c].resize(profile.names.size());
+        for (size_t rk = c; rk < profile.events.size(); rk += chunks)
+            add_durations(profile.events[rk], partial[c]);
+    });
+
+    std::vector<DurationSketch> sketches(profile.names.size());
+    for (auto& p : partial)
+        for (size_t id = 0; id < sketches.size(); ++id)
+            sketches[id].merge(p[id]);
+    return sketches;
+}
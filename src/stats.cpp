@@ -0,0 +1,327 @@
+#include <profvis/stats.h>
+
+#include <regex>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <cctype>
+#include <exception>
+#include <thread>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+#include <condition_variable>
+
+#include <fmt/format.h>
+
+namespace
+{
+
+// Lines of several ranks, separated by '\n'.
+using Batch = std::string;
+
+static constexpr size_t batch_size  = 1 << 20;
+static constexpr size_t queue_size  = 4;            // batches in flight per worker
+
+class BatchQueue
+{
+    public:
+        void        push(Batch batch)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [this]() { return batches_.size() < queue_size; });
+            batches_.emplace_back(std::move(batch));
+            not_empty_.notify_one();
+        }
+
+        // an empty batch marks the end of the input
+        Batch       pop()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [this]() { return !batches_.empty(); });
+            Batch batch = std::move(batches_.front());
+            batches_.pop_front();
+            not_full_.notify_one();
+            return batch;
+        }
+
+    private:
+        std::deque<Batch>           batches_;
+        std::mutex                  mutex_;
+        std::condition_variable     not_empty_, not_full_;
+};
+
+// Processes the lines of its ranks; the lines of each rank arrive in the order of the file.
+class Worker
+{
+    public:
+        using Time  = profvis::Profile::Time;
+
+                    Worker(const profvis::StatsOptions& options, const std::regex* regex):
+                        options_(options), regex_(regex)                        {}
+
+        void        run(BatchQueue& queue)
+        {
+            for (Batch batch = queue.pop(); !batch.empty(); batch = queue.pop())
+            {
+                const char* line = batch.data();
+                const char* end  = line + batch.size();
+                while (line < end)
+                {
+                    const char* eol = std::find(line, end, '\n');
+                    process(line, eol);
+                    line = eol + 1;
+                }
+            }
+        }
+
+        void        merge(profvis::ProfileStats& stats) const
+        {
+            for (auto& x : entries_)
+            {
+                auto& names = options_.full_name ? full_names_ : names_;
+                stats.segments[names[x.first.id]].ranks[x.first.rank] = x.second;
+            }
+
+            for (size_t id = 0; id < sketches_.size(); ++id)
+                if (sketches_[id].count())
+                {
+                    auto& names = options_.full_name ? full_names_ : names_;
+                    stats.segments[names[id]].durations.merge(sketches_[id]);
+                }
+
+            for (auto& x : stacks_)
+                if (!x.second.empty())
+                    stats.unbalanced = true;
+        }
+
+    private:
+        struct Frame
+        {
+            std::uint32_t   name, full_name;
+            Time            begin;
+        };
+
+        struct Key
+        {
+            std::uint32_t   id;
+            int             rank;
+
+            bool            operator==(const Key& other) const                  { return id == other.id && rank == other.rank; }
+        };
+
+        struct KeyHash
+        {
+            size_t          operator()(const Key& k) const                      { return std::hash<std::uint64_t>()((std::uint64_t(k.id) << 32) ^ std::uint32_t(k.rank)); }
+        };
+
+        void        process(const char* line, const char* eol)
+        {
+            char* after;
+            int rank = std::strtol(line, &after, 10);
+            const char* next = after;
+            while (next < eol && *next == ' ') ++next;
+            Time time = profvis::parse_time(next);
+            next = std::find(next, eol, ' ');
+            while (next < eol && *next == ' ') ++next;
+            if (next == eol)
+                return;
+
+            bool begin = *next == '<';
+            const char* name_end = next + 1;
+            while (name_end < eol && !std::isspace(*name_end)) ++name_end;
+
+            auto& stack = stacks_[rank];
+            Frame frame;
+            if (begin)
+            {
+                frame.name      = name_id(std::string(next + 1, name_end));
+                frame.full_name = full_name_id(stack.empty() ? none : stack.back().full_name, frame.name);
+                frame.begin     = time;
+                stack.push_back(frame);
+            } else
+            {
+                if (stack.empty())
+                    throw std::runtime_error(fmt::format("Unmatched end of an event on rank {}", rank));
+                frame = stack.back();
+                stack.pop_back();
+            }
+
+            std::uint32_t id = options_.full_name ? frame.full_name : frame.name;
+            if (!matches(id))
+                return;
+
+            auto& entry = entries_[Key { id, rank }];
+            if (begin)
+                ++entry.count;
+            else
+            {
+                // a name nested in itself counts only once, with its outermost occurrence; a full name can't be
+                bool nested = !options_.full_name &&
+                              std::any_of(stack.begin(), stack.end(), [&frame](const Frame& f) { return f.name == frame.name; });
+                if (!nested)
+                    entry.time += time - frame.begin;
+                entry.timed = true;
+
+                if (id >= sketches_.size())
+                    sketches_.resize(id + 1);
+                sketches_[id].add(time - frame.begin);
+            }
+        }
+
+        std::uint32_t   name_id(const std::string& name)
+        {
+            auto it = ids_.find(name);
+            if (it != ids_.end())
+                return it->second;
+
+            std::uint32_t id = names_.size();
+            names_.push_back(name);
+            ids_.emplace(name, id);
+            if (!options_.full_name)
+                matched_.push_back(unknown);
+            return id;
+        }
+
+        std::uint32_t   full_name_id(std::uint32_t parent, std::uint32_t name)
+        {
+            std::uint64_t key = (std::uint64_t(parent) << 32) | name;
+            auto it = full_ids_.find(key);
+            if (it != full_ids_.end())
+                return it->second;
+
+            std::uint32_t id = full_names_.size();
+            full_names_.push_back(parent == none ? names_[name] : full_names_[parent] + ':' + names_[name]);
+            full_ids_.emplace(key, id);
+            if (options_.full_name)
+                matched_.push_back(unknown);
+            return id;
+        }
+
+        // names are tested once, when first counted
+        bool        matches(std::uint32_t id)
+        {
+            if (matched_[id] == unknown)
+            {
+                auto& name = options_.full_name ? full_names_[id] : names_[id];
+                bool match;
+                if (name.empty())
+                    match = false;
+                else if (options_.segment.empty() && !regex_)
+                    match = true;
+                else
+                    match = name == options_.segment ||
+                            (regex_ && std::regex_search(name, *regex_, std::regex_constants::match_continuous));
+                matched_[id] = match ? yes : no;
+            }
+            return matched_[id] == yes;
+        }
+
+    private:
+        static constexpr std::uint32_t  none = static_cast<std::uint32_t>(-1);
+        enum Match : char { unknown, no, yes };
+
+        const profvis::StatsOptions&                    options_;
+        const std::regex*                               regex_;
+
+        std::unordered_map<std::string, std::uint32_t> ids_;
+        std::vector<std::string>                        names_;
+        std::unordered_map<std::uint64_t, std::uint32_t> full_ids_;     // (parent, name) -> full name
+        std::vector<std::string>                        full_names_;
+        std::vector<Match>                              matched_;       // for the ids in use (short or full)
+
+        std::unordered_map<int, std::vector<Frame>>     stacks_;
+        std::unordered_map<Key, profvis::SegmentStats::Rank, KeyHash>  entries_;
+        std::vector<profvis::DurationSketch>            sketches_;      // by id, merged over the ranks of the worker
+};
+
+constexpr std::uint32_t Worker::none;
+
+}
+
+profvis::ProfileStats
+profvis::
+compute_stats(std::string fn, const StatsOptions& options)
+{
+    std::unique_ptr<std::regex> regex;
+    if (!options.regex.empty())
+        regex.reset(new std::regex(options.regex, std::regex::ECMAScript | std::regex::optimize));
+
+    size_t n = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<BatchQueue>     queues(n);
+    std::vector<Worker>         workers(n, Worker(options, regex.get()));
+    std::vector<std::thread>    threads;
+    std::exception_ptr          error;
+    std::mutex                  error_mutex;
+    for (size_t i = 0; i < n; ++i)
+        threads.emplace_back([&,i]()
+        {
+            try
+            {
+                workers[i].run(queues[i]);
+            } catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+                // keep draining, so that the reader does not block
+                while (!queues[i].pop().empty());
+            }
+        });
+
+    std::vector<Batch> batches(n);
+    try
+    {
+        zstr::ifstream      in(fn);
+        std::string         line;
+        while (std::getline(in, line))
+        {
+            if (line.empty())
+                continue;
+
+            long rank = std::strtol(line.c_str(), nullptr, 10);
+            size_t i  = static_cast<size_t>(rank < 0 ? -rank : rank) % n;
+            auto& batch = batches[i];
+            batch += line;
+            batch += '\n';
+            if (batch.size() >= batch_size)
+            {
+                queues[i].push(std::move(batch));
+                batch.clear();
+            }
+        }
+    } catch (...)
+    {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) error = std::current_exception();
+    }
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (!batches[i].empty())
+            queues[i].push(std::move(batches[i]));
+        queues[i].push(Batch());
+    }
+    for (auto& t : threads)
+        t.join();
+
+    if (error)
+        std::rethrow_exception(error);
+
+    ProfileStats stats;
+    for (auto& w : workers)
+        w.merge(stats);
+    return stats;
+}
+
+std::string
+profvis::
+format_time(Profile::Time time)
+{
+    return fmt::format("{:02d}:{:02d}:{:02d}.{:06d}",
+                       time/1000000/60/60,
+                       time/1000000/60 % 60,
+                       time/1000000 % 60,
+                       time % 1000000);
+}
@@ -0,0 +1,48 @@
+#include <profvis/collectives.h>
+
+#include <cstdio>
+
+// Collectives nested in different collectives, on ranks that arrive in a different order:
+// the critical path used to jump between ranks 2 and 3 forever.
+int main()
+{
+    using Event = profvis::Profile::Event;
+
+    profvis::Profile profile;
+    profile.names = { "MPI_Allreduce", "MPI_Barrier", "compute" };
+    profile.events.resize(4);
+    for (auto& rank : profile.events)
+        rank.push_back(Event { 2, 0, 10, 0, {} });
+    profile.events[0].push_back(Event { 0, 12, 30, 0, {} });
+    profile.events[1].push_back(Event { 1, 11, 30, 0, {} });
+    profile.events[2].push_back(Event { 0, 17, 27, 0, { Event { 1, 19, 22, 0, {} } } });
+    profile.events[3].push_back(Event { 1, 18, 28, 0, { Event { 0, 21, 22, 0, {} } } });
+
+    auto collectives = profvis::analyze_collectives(profile);
+
+    int failures = 0;
+    auto check = [&failures](bool condition, const char* what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what);
+            ++failures;
+        }
+    };
+
+    // only the outermost collective of each nest is a call
+    for (auto& rank : collectives.ranks)
+        check(rank.size() == 1, "one arrival per rank");
+    check(collectives.instances.size() == 2, "one instance per name");
+    for (auto& instance : collectives.instances)
+        check(instance.ranks == 2, "two ranks per instance");
+
+    auto& path = collectives.critical_path;
+    check(!path.empty(), "critical path");
+    for (size_t i = 1; i < path.size(); ++i)
+        check(path[i - 1].end == path[i].begin, "contiguous critical path");
+    if (!path.empty())
+        check(path.front().begin == 0 && path.back().end == 30, "critical path spans the run");
+
+    return failures == 0 ? 0 : 1;
+}